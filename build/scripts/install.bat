@@ -8,4 +8,6 @@ set dir_path=%~dp0
 reg add "HKEY_CLASSES_ROOT\*\shell\DestroyFile" /f /ve /d "Destroy file"
 reg add "HKEY_CLASSES_ROOT\*\shell\DestroyFile\command" /f /ve /d "%dir_path%fshred.exe ""%%1"" -d"
 reg add "HKEY_CLASSES_ROOT\*\shell\DestroyFileContents" /f /ve /d "Destroy file contents"
-reg add "HKEY_CLASSES_ROOT\*\shell\DestroyFileContents\command" /f /ve /d "%dir_path%fshred.exe ""%%1""
\ No newline at end of file
+reg add "HKEY_CLASSES_ROOT\*\shell\DestroyFileContents\command" /f /ve /d "%dir_path%fshred.exe ""%%1""
+reg add "HKEY_CLASSES_ROOT\Directory\shell\DestroyFolder" /f /ve /d "Destroy folder"
+reg add "HKEY_CLASSES_ROOT\Directory\shell\DestroyFolder\command" /f /ve /d "%dir_path%fshred.exe ""%%1"" -d"
\ No newline at end of file
@@ -7,5 +7,6 @@
 set dir_path=%~dp0
 reg delete "HKEY_CLASSES_ROOT\*\shell\DestroyFile" /f
 reg delete "HKEY_CLASSES_ROOT\*\shell\DestroyFileContents" /f
+reg delete "HKEY_CLASSES_ROOT\Directory\shell\DestroyFolder" /f
 del "%dir_path%fshred.exe"
 del "%dir_path%install.bat"
\ No newline at end of file
@@ -0,0 +1,371 @@
+// batch.cpp
+
+// Copyright (c) Mateusz Jandura. All rights reserved.
+// SPDX-License-Identifier: Apache-2.0
+
+#include <fshred/batch.hpp>
+#include <fshred/kernels.hpp>
+#include <fshred/tinywin.hpp>
+#include <mjfs/directory.hpp>
+#include <mjfs/status.hpp>
+#include <utility>
+
+namespace mjx {
+    shred_batch::shred_batch(const program_options& _Options) noexcept
+        : _Myopts(_Options), _Myindex(), _Mybuffers(_Buffer_size, _Options.buffer_count), _Myjournal(),
+        _Myjournal_id{0, 0}, _Mymanifest(), _Mymanifest_id{0, 0}, _Mycancel(), _Mycancel_event(), _Mysched(),
+        _Mypaths(), _Mylinks(), _Mydirs(), _Myreport(), _Mycerts(), _Myresult(shred_status::success) {}
+
+    shred_batch::~shred_batch() noexcept {}
+
+    void shred_batch::_Report(const shred_status _Status) noexcept {
+        if (_Status != shred_status::success && _Myresult == shred_status::success) {
+            _Myresult = _Status; // remember the first failure, but shred the remaining files
+        }
+    }
+
+    void shred_batch::cancel() noexcept {
+        _Mycancel.request();
+    }
+
+    shred_batch::_Admission shred_batch::_Admit_file(const path& _Target, const bool _Delete,
+        shred_progress* const _Progress, size_t& _Slot, uint32_t& _Device) {
+        // Note: The identifier is queried through a handle without data access, so that it can be
+        //       obtained even if another link to the same file is already opened by a worker.
+        file_metadata _Meta;
+        bool _Identified;
+        {
+            file _Probe(_Target, file_access::none, file_share::all);
+            _Identified = _Probe.is_open() && query_file_metadata(_Probe, _Meta);
+        }
+
+        _Device = _Identified ? _Meta.id.volume : 0;
+        if (_Identified && _Is_own_file(_Meta.id)) { // the journal or the manifest is in the target
+            return _Admission::own_file;
+        }
+
+        const file_id _Id          = _Identified ? _Meta.id : file_id{0, 0};
+        const journal_entry _Entry = _Progress
+            ? _Progress->bind(_Slot, _Id) : journal_entry{0, 0, journal_state::none, 0, 0, 0, 0, 0};
+        if (!_Identified) { // cannot be recognized, shred it from the beginning
+            return _Admission::shred;
+        }
+
+        // Note: A file completed by an interrupted run has already been overwritten and truncated.
+        //       Unless it has been written since, it is only deleted if requested. Any file may be
+        //       reached twice, through another link, overlapping targets or a repeated path, so every
+        //       file is remembered.
+        _Admission _Result = _Admission::shred;
+        if (::mjx::is_completed(_Entry, _Meta)) {
+            _Myindex.insert(_Meta.id);
+            _Result = _Admission::completed;
+        } else if (!_Myindex.insert(_Meta.id)) { // shredded through another path
+            _Result = _Admission::linked;
+        }
+
+        if (_Result != _Admission::shred && _Delete) { // unlink at the end, once the other path is closed
+            _Mylinks.push_back(_Mypaths.insert(_Target));
+        }
+
+        return _Result;
+    }
+
+    void shred_batch::_Enqueue_file(const path& _Target) {
+        if (_Mycancel.requested()) { // stopped, do not open any more files
+            return;
+        }
+
+        size_t _Slot = shred_journal::npos;
+        uint32_t _Device;
+        if (_Admit_file(_Target, _Myopts.delete_after_shredding, _Myjournal.is_open() ? &_Myjournal : nullptr,
+            _Slot, _Device) != _Admission::shred) {
+            return;
+        }
+
+        shred_job _Job;
+        _Job.target                 = _Target;
+        _Job.delete_after_shredding = _Myopts.delete_after_shredding;
+        _Job.settings               = _Myopts.settings;
+        _Job.journal                = _Slot != shred_journal::npos ? &_Myjournal : nullptr;
+        _Job.journal_slot           = _Slot;
+        _Submit_file(::std::move(_Job), _Device);
+    }
+
+    void shred_batch::_Submit_file(shred_job&& _Job, const uint32_t _Device) {
+        // Note: The file is opened by a worker of its device once it is about to be shredded,
+        //       so the files waiting in the queues do not hold a handle. If the file could not be
+        //       identified, it is queued as if it was stored on a separate device. It is still shredded,
+        //       just not throttled together with its real device.
+        _Job.min_mapped_size = _Myopts.min_mapped_size;
+        _Mysched.submit(_Device, ::std::move(_Job));
+    }
+
+    void shred_batch::_Enqueue_directory(const path& _Target) {
+        if (_Myopts.delete_after_shredding) {
+            _Mydirs.push_back(_Mypaths.insert(_Target));
+        }
+
+        for (const directory_entry& _Entry : recursive_directory_iterator(_Target)) {
+            if (_Mycancel.requested()) { // stopped, do not walk the rest of the tree
+                return;
+            }
+
+            if (_Entry.is_symlink() || _Entry.is_junction()) { // never follow links outside the tree
+                continue;
+            }
+
+            if (_Entry.is_directory()) {
+                if (_Myopts.delete_after_shredding) {
+                    _Mydirs.push_back(_Mypaths.insert(_Entry.absolute_path()));
+                }
+            } else if (_Entry.is_regular_file()) {
+                _Enqueue_file(_Entry.absolute_path());
+            }
+        }
+    }
+
+    void shred_batch::_Enqueue_target(const path& _Target) {
+        if (::mjx::is_directory(_Target)) {
+            _Enqueue_directory(_Target);
+        } else {
+            _Enqueue_file(_Target);
+        }
+    }
+
+    void shred_batch::_Enqueue_list() {
+        // Note: The scheduler blocks while its backlog is full, so the list is read only as fast
+        //       as the files are shredded. Shredding starts with the first listed path.
+        path_list _List;
+        if (!_List.open(_Myopts.list_path)) {
+            _Report(shred_status::bad_file);
+            return;
+        }
+
+        path _Target;
+        while (!_Mycancel.requested() && _List.next(_Target)) {
+            if (_Target.empty()) { // too long to be a path
+                _Report(shred_status::bad_file);
+                continue;
+            }
+
+            _Enqueue_target(_Target);
+        }
+
+        if (_List.failed()) { // some targets may have not been read
+            _Report(shred_status::bad_file);
+        }
+    }
+
+    void shred_batch::_Enqueue_record(const size_t _Slot) {
+        const manifest_record& _Rec     = _Mymanifest.record(_Slot);
+        const unicode_string_view _Path = _Mymanifest.target(_Slot);
+        if (_Path.empty() || (_Rec.method != shred_manifest::default_method
+            && _Rec.method > static_cast<uint8_t>(shred_method::nist_800_88_clear))) { // damaged record
+            _Mymanifest.finish(_Slot, shred_status::bad_file, file_metadata{file_id{0, 0}, 0, 0, 0, 0});
+            _Report(shred_status::bad_file);
+            return;
+        }
+
+        // Note: A file shredded and deleted by an earlier run no longer exists. Probing it would reset
+        //       its progress and overwrite the stored result with a failure, so the record is kept.
+        const path _Target(_Path);
+        const manifest_status _Stored = static_cast<manifest_status>(_Rec.status);
+        const bool _Finished          = _Stored == manifest_status::shredded
+            || _Stored == manifest_status::not_deleted || _Stored == manifest_status::linked
+            || _Rec.progress.state == journal_state::completed;
+        if (_Finished && !::mjx::exists(_Target)) { // nothing left to shred, keep the earlier result
+            return;
+        }
+
+        const bool _Delete = _Myopts.delete_after_shredding
+            || (_Rec.flags & static_cast<uint8_t>(manifest_flag::delete_after_shredding)) != 0;
+        size_t _Progress_slot = _Slot;
+        uint32_t _Device;
+        switch (_Admit_file(_Target, _Delete, &_Mymanifest, _Progress_slot, _Device)) {
+        case _Admission::shred:
+            break;
+        case _Admission::own_file:
+            _Mymanifest.mark(_Slot, manifest_status::skipped);
+            return;
+        case _Admission::linked:
+            _Mymanifest.mark(_Slot, manifest_status::linked);
+            return;
+        default: // completed, keep the status of the earlier run
+            return;
+        }
+
+        shred_job _Job;
+        _Job.target                 = _Target;
+        _Job.delete_after_shredding = _Delete;
+        _Job.settings               = _Myopts.settings;
+        _Job.journal                = &_Mymanifest; // an unidentified file starts from the beginning
+        _Job.journal_slot           = _Slot;
+        if (_Rec.method != shred_manifest::default_method) {
+            _Job.settings.method = static_cast<shred_method>(_Rec.method);
+        }
+
+        _Submit_file(::std::move(_Job), _Device);
+    }
+
+    void shred_batch::_Enqueue_manifest() {
+        // Note: The records are read straight from the mapped manifest and only the record being
+        //       enqueued is touched, so the manifest is never copied into memory.
+        const size_t _Count = _Mymanifest.size();
+        for (size_t _Slot = 0; _Slot < _Count && !_Mycancel.requested(); ++_Slot) {
+            _Enqueue_record(_Slot);
+        }
+    }
+
+    bool shred_batch::_Is_own_file(const file_id& _Id) const noexcept {
+        return (_Myjournal.is_open() && _Id == _Myjournal_id)
+            || (_Mymanifest.is_open() && _Id == _Mymanifest_id);
+    }
+
+    void shred_batch::_Remove_leftovers() {
+        for (const path_table::index_type _Idx : _Mylinks) {
+            const path _Link = _Mypaths.at(_Idx);
+            if (!::mjx::delete_file(_Link) && ::mjx::exists(_Link)) {
+                _Report(shred_status::cannot_delete_file);
+            }
+        }
+
+        if (_Myresult != shred_status::success) { // some files may still exist, keep the directories
+            return;
+        }
+
+        for (auto _Iter = _Mydirs.rbegin(); _Iter != _Mydirs.rend(); ++_Iter) {
+            if (!::mjx::remove_directory(_Mypaths.at(*_Iter))) {
+                _Report(shred_status::cannot_delete_file);
+                return;
+            }
+        }
+    }
+
+    inline const char* _Concurrency_decision_name(const concurrency_decision _Decision) noexcept {
+        switch (_Decision) {
+        case concurrency_decision::increase:
+            return "increase";
+        case concurrency_decision::hold:
+            return "hold";
+        case concurrency_decision::decrease:
+            return "decrease";
+        default:
+            return "none";
+        }
+    }
+
+    void shred_batch::_Write_report() {
+        if (_Myopts.report_path.empty()) { // report not requested, do nothing
+            return;
+        }
+
+        _Myreport.print("kernels: %s", simd_level_name(bound_simd_level()));
+        if (_Mybuffers.valid()) {
+            _Myreport.print("buffers: %zu x %zu KiB, large pages %s, locked %s, exhausted %llu times",
+                _Mybuffers.buffer_count(), _Mybuffers.buffer_size() / 1024,
+                _Mybuffers.large_pages() ? "yes" : "no", _Mybuffers.locked() ? "yes" : "no",
+                static_cast<unsigned long long>(_Mybuffers.exhausted()));
+        }
+
+        for (const device_stats& _Stats : _Mysched.stats()) {
+            const concurrency_stats& _Conc = _Stats.concurrency;
+            _Myreport.print("device %08X: concurrency %zu (%zu-%zu), last decision %s, %llu increases, "
+                "%llu decreases, %.1f MiB/s, latency %.3f ms/MiB (base %.3f ms/MiB)", _Stats.device,
+                _Conc.limit, _Conc.min_limit, _Conc.max_limit,
+                _Concurrency_decision_name(_Conc.last_decision),
+                static_cast<unsigned long long>(_Conc.increases),
+                static_cast<unsigned long long>(_Conc.decreases), _Conc.throughput / 1048576.0,
+                _Conc.latency * 1000.0, _Conc.base_latency * 1000.0);
+        }
+
+        if (!_Myreport.save(_Myopts.report_path)) {
+            _Report(shred_status::cannot_write_report);
+        }
+    }
+
+    void shred_batch::_Write_certificates() {
+        if (_Myopts.certificate_path.empty()) { // certificates not requested, do nothing
+            return;
+        }
+
+        if (_Mycerts.failed()) { // the certificates have been written as the files finished
+            _Report(shred_status::cannot_write_report);
+        }
+    }
+
+    shred_status shred_batch::run() {
+        if (_Myopts.max_concurrency != 0) { // a fixed concurrency disables the controller
+            _Mysched.override_limits({_Myopts.max_concurrency, _Myopts.max_concurrency});
+        }
+
+        _Mysched.backlog_limit(_Myopts.queue_depth);
+
+        if (!_Myopts.report_path.empty()) { // report every file
+            _Mysched.attach_report(&_Myreport);
+        }
+
+        if (!_Myopts.certificate_path.empty()) { // certify every file as soon as its result is final
+            if (!_Mycerts.open(_Myopts.certificate_path)) { // never destroy files without the evidence
+                return shred_status::cannot_write_report;
+            }
+
+            _Mysched.attach_certificates(&_Mycerts);
+        }
+
+        if (_Myopts.buffer_count != 0) { // never fall back to small chunks without telling the user
+            if (!_Mybuffers.valid()) {
+                return shred_status::cannot_allocate_buffers;
+            }
+
+            _Mysched.attach_buffers(&_Mybuffers);
+        }
+
+        if (!_Myopts.cancel_event.empty()) { // another process may stop the batch
+            _Mycancel_event.watch(_Myopts.cancel_event, _Mycancel); // otherwise the batch runs to the end
+        }
+
+        _Mysched.attach_cancellation(&_Mycancel);
+
+        if (!_Myopts.journal_path.empty()) { // resume the files interrupted by a previous run
+            if (!_Myjournal.open(_Myopts.journal_path)) { // never shred without the requested journal
+                return shred_status::cannot_open_journal;
+            }
+
+            _Myjournal.identify(_Myjournal_id);
+        }
+
+        if (!_Myopts.manifest_path.empty()) { // the manifest holds its own progress
+            if (!_Mymanifest.open(_Myopts.manifest_path)) {
+                return shred_status::cannot_open_manifest;
+            }
+
+            _Mymanifest.identify(_Mymanifest_id);
+        }
+
+        _Mysched.throttle().limits(_Myopts.global_io_limits);
+        _Mysched.device_io_limits(_Myopts.device_io_limits);
+
+        for (const path& _Target : _Myopts.targets) {
+            _Enqueue_target(_Target);
+        }
+
+        if (!_Myopts.list_path.empty()) {
+            _Enqueue_list();
+        }
+
+        if (_Mymanifest.is_open()) {
+            _Enqueue_manifest();
+        }
+
+        _Report(_Mysched.wait());
+        if (_Mycancel.requested()) { // some files have not been shredded, keep their links and directories
+            _Report(shred_status::cancelled);
+        } else {
+            _Remove_leftovers();
+        }
+
+        _Write_report();
+        _Write_certificates();
+        return _Myresult;
+    }
+} // namespace mjx
\ No newline at end of file
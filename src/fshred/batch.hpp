@@ -0,0 +1,111 @@
+// batch.hpp
+
+// Copyright (c) Mateusz Jandura. All rights reserved.
+// SPDX-License-Identifier: Apache-2.0
+
+#pragma once
+#ifndef _FSHRED_BATCH_HPP_
+#define _FSHRED_BATCH_HPP_
+#include <cstddef>
+#include <cstdint>
+#include <fshred/buffer.hpp>
+#include <fshred/cancel.hpp>
+#include <fshred/identity.hpp>
+#include <fshred/job.hpp>
+#include <fshred/journal.hpp>
+#include <fshred/manifest.hpp>
+#include <fshred/pathlist.hpp>
+#include <fshred/pathtable.hpp>
+#include <fshred/program.hpp>
+#include <fshred/report.hpp>
+#include <fshred/scheduler.hpp>
+#include <mjfs/file.hpp>
+#include <mjfs/path.hpp>
+#include <vector>
+
+namespace mjx {
+    class shred_batch { // shreds all targets specified by the program options
+    public:
+        explicit shred_batch(const program_options& _Options) noexcept;
+        ~shred_batch() noexcept;
+
+        shred_batch(const shred_batch&)            = delete;
+        shred_batch& operator=(const shred_batch&) = delete;
+
+        // shreds all targets, returns the first failure
+        shred_status run();
+
+        // stops the running files at the next chunk boundary and skips the remaining ones
+        void cancel() noexcept;
+
+    private:
+        // records the result of a single file
+        void _Report(const shred_status _Status) noexcept;
+
+        // enqueues a single file or the contents of a directory
+        void _Enqueue_target(const path& _Target);
+
+        // enqueues every target of the list while it is being read
+        void _Enqueue_list();
+
+        // enqueues all files in the directory tree
+        void _Enqueue_directory(const path& _Target);
+
+        // enqueues every record of the manifest that has not been completed yet
+        void _Enqueue_manifest();
+
+        // enqueues the file of a single record
+        void _Enqueue_record(const size_t _Slot);
+
+        // enqueues a single file, other paths to an already enqueued file are only unlinked
+        void _Enqueue_file(const path& _Target);
+
+        enum class _Admission : unsigned char {
+            shred, // the file has to be shredded
+            own_file, // the journal or the manifest, never shredded
+            completed, // shredded by an earlier run and not written since
+            linked // shredded through another path to the same file
+        };
+
+        // identifies the file, binds it to its progress and decides whether it has to be shredded,
+        // a file that does not have to be is only unlinked at the end if requested
+        _Admission _Admit_file(const path& _Target, const bool _Delete, shred_progress* const _Progress,
+            size_t& _Slot, uint32_t& _Device);
+
+        // submits the prepared job to the scheduler, the file is opened by a worker
+        void _Submit_file(shred_job&& _Job, const uint32_t _Device);
+
+        // checks whether the file is the journal or the manifest
+        bool _Is_own_file(const file_id& _Id) const noexcept;
+
+        // removes the remaining hard links and the emptied directories
+        void _Remove_leftovers();
+
+        // writes the report if requested
+        void _Write_report();
+
+        // reports the erasure certificates that could not be written
+        void _Write_certificates();
+
+        static constexpr size_t _Buffer_size = 256 * 1024;
+
+        const program_options& _Myopts;
+        file_id_index _Myindex; // every identified file, so that none is shredded twice
+        buffer_pool _Mybuffers; // must outlive the scheduler
+        shred_journal _Myjournal; // must outlive the scheduler
+        file_id _Myjournal_id; // the journal itself is never shredded
+        shred_manifest _Mymanifest; // must outlive the scheduler
+        file_id _Mymanifest_id; // the manifest itself is never shredded
+        cancellation_token _Mycancel; // must outlive the scheduler
+        cancel_event _Mycancel_event; // requests the cancellation on behalf of another process
+        shred_scheduler _Mysched;
+        path_table _Mypaths; // paths kept until the end of the batch, there may be millions of them
+        ::std::vector<path_table::index_type> _Mylinks; // paths to files shredded through another path
+        ::std::vector<path_table::index_type> _Mydirs; // directories in pre-order
+        shred_report _Myreport;
+        shred_report _Mycerts;
+        shred_status _Myresult;
+    };
+} // namespace mjx
+
+#endif // _FSHRED_BATCH_HPP_
\ No newline at end of file
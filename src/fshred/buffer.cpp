@@ -0,0 +1,213 @@
+// buffer.cpp
+
+// Copyright (c) Mateusz Jandura. All rights reserved.
+// SPDX-License-Identifier: Apache-2.0
+
+#include <algorithm>
+#include <cstring>
+#include <fshred/buffer.hpp>
+#include <fshred/tinywin.hpp>
+#include <limits>
+
+namespace mjx {
+    inline bool _Enable_lock_memory_privilege() noexcept {
+        // Note: Large pages are always locked, so allocating them requires SeLockMemoryPrivilege.
+        //       The privilege must be granted to the user, here it is only enabled.
+        HANDLE _Token;
+        if (!::OpenProcessToken(::GetCurrentProcess(), TOKEN_ADJUST_PRIVILEGES | TOKEN_QUERY, &_Token)) {
+            return false;
+        }
+
+        TOKEN_PRIVILEGES _Privileges;
+        _Privileges.PrivilegeCount           = 1;
+        _Privileges.Privileges[0].Attributes = SE_PRIVILEGE_ENABLED;
+        bool _Enabled                        = false;
+        if (::LookupPrivilegeValueW(nullptr, SE_LOCK_MEMORY_NAME, &_Privileges.Privileges[0].Luid)) {
+            // AdjustTokenPrivileges() succeeds even if the privilege has not been granted
+            _Enabled = ::AdjustTokenPrivileges(_Token, FALSE, &_Privileges, 0, nullptr, nullptr)
+                && ::GetLastError() == ERROR_SUCCESS;
+        }
+
+        ::CloseHandle(_Token);
+        return _Enabled;
+    }
+
+    buffer_pool::buffer_pool(const size_t _Buffer_size, const size_t _Count) noexcept
+        : _Mydata(nullptr), _Mysize(0), _Mybuf_size(_Buffer_size), _Mybuf_count(0), _Mylarge_pages(false),
+        _Mylocked(false), _Myhead(_Null_index), _Mynext(), _Myexhausted(0), _Mymtx(), _Myreleased() {
+        if (_Buffer_size == 0 || _Count == 0 || _Count >= _Null_index) { // nothing to allocate or too much
+            return;
+        }
+
+        if (_Count > (::std::numeric_limits<size_t>::max)() / _Buffer_size) { // the size would overflow
+            return;
+        }
+
+        try {
+            _Mynext = ::std::vector<::std::atomic<uint32_t>>(_Count);
+        } catch (...) {
+            return;
+        }
+
+        if (!_Allocate(_Buffer_size * _Count)) {
+            return;
+        }
+
+        _Mylocked = _Mylarge_pages || _Pin(_Mysize); // large pages cannot be paged out anyway
+
+        // link all buffers, the first buffer is at the top
+        for (size_t _Idx = 0; _Idx + 1 < _Count; ++_Idx) {
+            _Mynext[_Idx].store(static_cast<uint32_t>(_Idx + 1), ::std::memory_order_relaxed);
+        }
+
+        _Mynext[_Count - 1].store(_Null_index, ::std::memory_order_relaxed);
+
+        _Mybuf_count = _Count;
+        _Myhead.store(0, ::std::memory_order_release);
+    }
+
+    buffer_pool::~buffer_pool() noexcept {
+        if (_Mydata) {
+            if (_Mylocked && !_Mylarge_pages) {
+                ::VirtualUnlock(_Mydata, _Mysize);
+            }
+
+            ::VirtualFree(_Mydata, 0, MEM_RELEASE);
+            _Mydata = nullptr;
+        }
+    }
+
+    bool buffer_pool::_Allocate(const size_t _Size) noexcept {
+        const size_t _Large_page_size = ::GetLargePageMinimum();
+        if (_Large_page_size != 0 && _Enable_lock_memory_privilege()) {
+            // the size of a large-page allocation must be a multiple of the large page size
+            const size_t _Large_size = (_Size + _Large_page_size - 1) / _Large_page_size * _Large_page_size;
+            _Mydata                  = static_cast<byte_t*>(::VirtualAlloc(
+                nullptr, _Large_size, MEM_RESERVE | MEM_COMMIT | MEM_LARGE_PAGES, PAGE_READWRITE));
+            if (_Mydata) {
+                _Mysize        = _Large_size;
+                _Mylarge_pages = true;
+                return true;
+            }
+        }
+
+        _Mydata = static_cast<byte_t*>(
+            ::VirtualAlloc(nullptr, _Size, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE));
+        if (!_Mydata) {
+            return false;
+        }
+
+        _Mysize = _Size;
+        return true;
+    }
+
+    bool buffer_pool::_Pin(const size_t _Size) noexcept {
+        ::memset(_Mydata, 0, _Size); // fault in every page now, not while shredding
+
+        // Note: VirtualLock() fails if the locked memory would not fit in the minimum working set,
+        //       so the working set is grown first.
+        SIZE_T _Min;
+        SIZE_T _Max;
+        const HANDLE _Process = ::GetCurrentProcess();
+        if (!::GetProcessWorkingSetSize(_Process, &_Min, &_Max)
+            || !::SetProcessWorkingSetSize(_Process, _Min + _Size, (::std::max)(_Max, _Min + _Size))) {
+            return false;
+        }
+
+        return ::VirtualLock(_Mydata, _Size) != 0;
+    }
+
+    bool buffer_pool::valid() const noexcept {
+        return _Mydata != nullptr;
+    }
+
+    bool buffer_pool::large_pages() const noexcept {
+        return _Mylarge_pages;
+    }
+
+    bool buffer_pool::locked() const noexcept {
+        return _Mylocked;
+    }
+
+    size_t buffer_pool::buffer_size() const noexcept {
+        return _Mybuf_size;
+    }
+
+    size_t buffer_pool::buffer_count() const noexcept {
+        return _Mybuf_count;
+    }
+
+    uint64_t buffer_pool::_Make_head(const uint64_t _Old_head, const uint32_t _Top) noexcept {
+        return (((_Old_head >> 32) + 1) << 32) | _Top;
+    }
+
+    uint64_t buffer_pool::exhausted() const noexcept {
+        return _Myexhausted.load(::std::memory_order_relaxed);
+    }
+
+    byte_t* buffer_pool::_Try_acquire() noexcept {
+        uint64_t _Head = _Myhead.load(::std::memory_order_acquire);
+        uint32_t _Top;
+        do {
+            _Top = static_cast<uint32_t>(_Head);
+            if (_Top == _Null_index) { // all buffers are in use
+                return nullptr;
+            }
+        } while (!_Myhead.compare_exchange_weak(_Head, _Make_head(_Head, _Mynext[_Top].load(
+            ::std::memory_order_relaxed)), ::std::memory_order_acquire, ::std::memory_order_acquire));
+
+        return _Mydata + static_cast<size_t>(_Top) * _Mybuf_size;
+    }
+
+    byte_t* buffer_pool::acquire() noexcept {
+        if (_Mybuf_count == 0) { // nothing to wait for
+            return nullptr;
+        }
+
+        byte_t* _Buf = _Try_acquire();
+        if (_Buf) {
+            return _Buf;
+        }
+
+        // Note: A worker holds its buffer for the whole file, so a worker without one would write it
+        //       in small chunks, which under -nocache means tiny transfers. Waiting for a buffer costs
+        //       less. The buffer is taken under the lock, so a release cannot slip in unnoticed.
+        _Myexhausted.fetch_add(1, ::std::memory_order_relaxed);
+        ::std::unique_lock<::std::mutex> _Lock(_Mymtx);
+        _Myreleased.wait(_Lock, [this, &_Buf] { return (_Buf = _Try_acquire()) != nullptr; });
+        return _Buf;
+    }
+
+    void buffer_pool::release(byte_t* const _Buf) noexcept {
+        const uint32_t _Idx = static_cast<uint32_t>(static_cast<size_t>(_Buf - _Mydata) / _Mybuf_size);
+        uint64_t _Head      = _Myhead.load(::std::memory_order_relaxed);
+        do {
+            _Mynext[_Idx].store(static_cast<uint32_t>(_Head), ::std::memory_order_relaxed);
+        } while (!_Myhead.compare_exchange_weak(
+            _Head, _Make_head(_Head, _Idx), ::std::memory_order_release, ::std::memory_order_relaxed));
+
+        {
+            ::std::lock_guard<::std::mutex> _Guard(_Mymtx); // a waiter cannot miss the returned buffer
+        }
+
+        _Myreleased.notify_one();
+    }
+
+    _Pooled_buffer::_Pooled_buffer(buffer_pool* const _Pool) noexcept
+        : _Mypool(_Pool), _Mybuf(_Pool ? _Pool->acquire() : nullptr) {}
+
+    _Pooled_buffer::~_Pooled_buffer() noexcept {
+        if (_Mybuf) {
+            _Mypool->release(_Mybuf);
+            _Mybuf = nullptr;
+        }
+    }
+
+    byte_t* _Pooled_buffer::_Get() const noexcept {
+        return _Mybuf;
+    }
+
+    size_t _Pooled_buffer::_Size() const noexcept {
+        return _Mybuf ? _Mypool->buffer_size() : 0;
+    }
+} // namespace mjx
\ No newline at end of file
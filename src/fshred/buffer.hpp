@@ -0,0 +1,102 @@
+// buffer.hpp
+
+// Copyright (c) Mateusz Jandura. All rights reserved.
+// SPDX-License-Identifier: Apache-2.0
+
+#pragma once
+#ifndef _FSHRED_BUFFER_HPP_
+#define _FSHRED_BUFFER_HPP_
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <mjstr/char_traits.hpp>
+#include <mutex>
+#include <vector>
+
+namespace mjx {
+    class buffer_pool { // pre-faulted, locked buffers of equal size, lock-free until exhausted
+    public:
+        buffer_pool(const size_t _Buffer_size, const size_t _Count) noexcept;
+        ~buffer_pool() noexcept;
+
+        buffer_pool(const buffer_pool&)            = delete;
+        buffer_pool& operator=(const buffer_pool&) = delete;
+
+        // checks whether the memory has been allocated
+        bool valid() const noexcept;
+
+        // checks whether the memory is backed by large pages
+        bool large_pages() const noexcept;
+
+        // checks whether the memory is locked in the working set
+        bool locked() const noexcept;
+
+        // returns the size of each buffer
+        size_t buffer_size() const noexcept;
+
+        // returns the number of buffers
+        size_t buffer_count() const noexcept;
+
+        // returns how many times a buffer has been waited for because all of them were in use
+        uint64_t exhausted() const noexcept;
+
+        // takes a free buffer, waits for one if all are in use, returns null if the pool is empty
+        byte_t* acquire() noexcept;
+
+        // returns the buffer to the pool
+        void release(byte_t* const _Buf) noexcept;
+
+    private:
+        // allocates the memory, preferably with large pages
+        bool _Allocate(const size_t _Size) noexcept;
+
+        // touches and locks the memory, so that it never faults nor gets paged out
+        bool _Pin(const size_t _Size) noexcept;
+
+        // takes a free buffer, returns null if there is none
+        byte_t* _Try_acquire() noexcept;
+
+        // Note: The free buffers form a stack linked through their indexes. The head holds the index
+        //       of the top buffer in its lower half and a tag in its upper half. The tag changes with
+        //       every update, so a head that has been popped and pushed back in the meantime is not
+        //       mistaken for an unchanged one.
+        static constexpr uint32_t _Null_index = 0xFFFF'FFFF;
+
+        // returns the head with the specified top buffer and a new tag
+        static uint64_t _Make_head(const uint64_t _Old_head, const uint32_t _Top) noexcept;
+
+        byte_t* _Mydata;
+        size_t _Mysize; // size of the whole allocation
+        size_t _Mybuf_size;
+        size_t _Mybuf_count;
+        bool _Mylarge_pages;
+        bool _Mylocked;
+        ::std::atomic<uint64_t> _Myhead;
+        ::std::vector<::std::atomic<uint32_t>> _Mynext; // index of the next free buffer
+        ::std::atomic<uint64_t> _Myexhausted;
+        ::std::mutex _Mymtx;
+        ::std::condition_variable _Myreleased; // signaled on every returned buffer
+    };
+
+    class _Pooled_buffer { // buffer borrowed from a pool for the lifetime of the object
+    public:
+        explicit _Pooled_buffer(buffer_pool* const _Pool) noexcept;
+        ~_Pooled_buffer() noexcept;
+
+        _Pooled_buffer(const _Pooled_buffer&)            = delete;
+        _Pooled_buffer& operator=(const _Pooled_buffer&) = delete;
+
+        // returns the buffer, null if none has been borrowed
+        byte_t* _Get() const noexcept;
+
+        // returns the buffer size
+        size_t _Size() const noexcept;
+
+    private:
+        buffer_pool* _Mypool;
+        byte_t* _Mybuf;
+    };
+} // namespace mjx
+
+#endif // _FSHRED_BUFFER_HPP_
\ No newline at end of file
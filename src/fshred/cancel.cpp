@@ -0,0 +1,70 @@
+// cancel.cpp
+
+// Copyright (c) Mateusz Jandura. All rights reserved.
+// SPDX-License-Identifier: Apache-2.0
+
+#include <fshred/cancel.hpp>
+
+namespace mjx {
+    cancellation_token::cancellation_token() noexcept : _Myflag(false) {}
+
+    cancellation_token::~cancellation_token() noexcept {}
+
+    void cancellation_token::request() noexcept {
+        _Myflag.store(true, ::std::memory_order_relaxed);
+    }
+
+    bool cancellation_token::requested() const noexcept {
+        // Note: The flag is checked once per chunk, it does not guard any data, so a relaxed load
+        //       is enough. The shredder observes the request within a few chunks at worst.
+        return _Myflag.load(::std::memory_order_relaxed);
+    }
+
+    cancel_event::cancel_event() noexcept : _Myevent(nullptr), _Mystop(nullptr), _Mythread() {}
+
+    cancel_event::~cancel_event() noexcept {
+        _Stop();
+    }
+
+    void cancel_event::_Stop() noexcept {
+        if (_Mythread.joinable()) {
+            ::SetEvent(_Mystop);
+            _Mythread.join();
+        }
+
+        if (_Myevent) {
+            ::CloseHandle(_Myevent);
+            _Myevent = nullptr;
+        }
+
+        if (_Mystop) {
+            ::CloseHandle(_Mystop);
+            _Mystop = nullptr;
+        }
+    }
+
+    bool cancel_event::watch(const unicode_string& _Name, cancellation_token& _Token) noexcept {
+        // Note: The event is manual-reset, so the request is not lost if it is signaled before
+        //       the watcher starts to wait for it, or if another process waits for it as well.
+        _Stop();
+        _Myevent = ::CreateEventW(nullptr, TRUE, FALSE, _Name.c_str());
+        _Mystop  = ::CreateEventW(nullptr, TRUE, FALSE, nullptr);
+        if (!_Myevent || !_Mystop) {
+            _Stop();
+            return false;
+        }
+
+        const HANDLE _Events[2] = {_Myevent, _Mystop};
+        try {
+            _Mythread = ::std::thread([&_Token, _Events] {
+                if (::WaitForMultipleObjects(2, _Events, FALSE, INFINITE) == WAIT_OBJECT_0) {
+                    _Token.request();
+                }
+            });
+            return true;
+        } catch (...) {
+            _Stop();
+            return false;
+        }
+    }
+} // namespace mjx
\ No newline at end of file
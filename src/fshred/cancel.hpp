@@ -0,0 +1,54 @@
+// cancel.hpp
+
+// Copyright (c) Mateusz Jandura. All rights reserved.
+// SPDX-License-Identifier: Apache-2.0
+
+#pragma once
+#ifndef _FSHRED_CANCEL_HPP_
+#define _FSHRED_CANCEL_HPP_
+#include <atomic>
+#include <fshred/tinywin.hpp>
+#include <mjstr/string.hpp>
+#include <thread>
+
+namespace mjx {
+    class cancellation_token { // asks the shredder to stop at the next chunk boundary
+    public:
+        cancellation_token() noexcept;
+        ~cancellation_token() noexcept;
+
+        cancellation_token(const cancellation_token&)            = delete;
+        cancellation_token& operator=(const cancellation_token&) = delete;
+
+        // requests the cancellation, may be called from any thread
+        void request() noexcept;
+
+        // checks whether the cancellation has been requested
+        bool requested() const noexcept;
+
+    private:
+        ::std::atomic<bool> _Myflag;
+    };
+
+    class cancel_event { // requests the cancellation once another process signals a named event
+    public:
+        cancel_event() noexcept;
+        ~cancel_event() noexcept;
+
+        cancel_event(const cancel_event&)            = delete;
+        cancel_event& operator=(const cancel_event&) = delete;
+
+        // creates or opens the event and starts watching it, the token must outlive the watcher
+        bool watch(const unicode_string& _Name, cancellation_token& _Token) noexcept;
+
+    private:
+        // stops watching the event and closes it
+        void _Stop() noexcept;
+
+        HANDLE _Myevent; // signaled by the process that cancels the batch
+        HANDLE _Mystop; // signaled when the watcher is no longer needed
+        ::std::thread _Mythread;
+    };
+} // namespace mjx
+
+#endif // _FSHRED_CANCEL_HPP_
\ No newline at end of file
@@ -0,0 +1,112 @@
+// certificate.cpp
+
+// Copyright (c) Mateusz Jandura. All rights reserved.
+// SPDX-License-Identifier: Apache-2.0
+
+#include <algorithm>
+#include <chrono>
+#include <cstdarg>
+#include <cstdio>
+#include <ctime>
+#include <fshred/certificate.hpp>
+#include <mjstr/conversion.hpp>
+
+namespace mjx {
+    inline void _Append_line(utf8_string& _Text, const char* const _Fmt, ...) {
+        char _Line[256]; // the path is appended separately, every other line is short
+        va_list _Args;
+        va_start(_Args, _Fmt);
+        const int _Length = ::vsnprintf(_Line, sizeof(_Line), _Fmt, _Args);
+        va_end(_Args);
+        if (_Length > 0) {
+            _Text.append(_Line, (::std::min)(static_cast<size_t>(_Length), sizeof(_Line) - 1));
+        }
+
+        _Text.push_back('\n');
+    }
+
+    inline void _Format_time(const ::std::chrono::system_clock::time_point _Time, char (&_Buf)[32]) noexcept {
+        // formats the time as ISO 8601 in UTC, with milliseconds
+        if (_Time == ::std::chrono::system_clock::time_point{}) { // never recorded, the file did not start
+            ::snprintf(_Buf, sizeof(_Buf), "unknown");
+            return;
+        }
+
+        const ::std::time_t _Seconds = ::std::chrono::system_clock::to_time_t(_Time);
+        const long long _Millis      = ::std::chrono::duration_cast<::std::chrono::milliseconds>(
+            _Time.time_since_epoch()).count() % 1000;
+        ::std::tm _Utc;
+        if (::gmtime_s(&_Utc, &_Seconds) != 0) {
+            ::snprintf(_Buf, sizeof(_Buf), "unknown");
+            return;
+        }
+
+        ::snprintf(_Buf, sizeof(_Buf), "%04d-%02d-%02dT%02d:%02d:%02d.%03lldZ", _Utc.tm_year + 1900,
+            _Utc.tm_mon + 1, _Utc.tm_mday, _Utc.tm_hour, _Utc.tm_min, _Utc.tm_sec, _Millis);
+    }
+
+    inline void _Format_digest(const byte_t (&_Digest)[sha256_digest_size],
+        char (&_Buf)[2 * sha256_digest_size + 1]) noexcept {
+        static constexpr char _Digits[] = "0123456789abcdef";
+        for (size_t _Idx = 0; _Idx < sha256_digest_size; ++_Idx) {
+            _Buf[2 * _Idx]     = _Digits[_Digest[_Idx] >> 4];
+            _Buf[2 * _Idx + 1] = _Digits[_Digest[_Idx] & 0x0F];
+        }
+
+        _Buf[2 * sha256_digest_size] = '\0';
+    }
+
+    void print_certificate(
+        shred_report& _Report, const shred_job& _Job, const shred_status _Status) noexcept {
+        // Note: The certificate is built first and then appended at once, so that the certificates
+        //       of files finished by different workers never interleave.
+        try {
+            const shred_stats& _Stats = _Job.stats;
+            char _Started[32];
+            char _Finished[32];
+            char _Digest[2 * sha256_digest_size + 1];
+            _Format_time(_Stats.started, _Started);
+            _Format_time(_Stats.finished, _Finished);
+
+            utf8_string _Text = "certificate\n    file: ";
+            _Text.append(::mjx::to_utf8_string(_Job.target.native()));
+            _Text.push_back('\n');
+            _Append_line(_Text, "    size: %llu bytes", static_cast<unsigned long long>(_Stats.file_size));
+            _Append_line(_Text, "    method: %s", shred_method_name(_Job.settings.method));
+            _Append_line(_Text, "    status: %s", shred_status_name(_Status));
+            _Append_line(_Text, "    started: %s", _Started);
+            _Append_line(_Text, "    finished: %s", _Finished);
+            if (_Stats.zeroing_offloaded) {
+                _Append_line(_Text, "    pass 0: zeroed by the file system");
+            }
+
+            for (uint8_t _Which = 0; _Which < 8; ++_Which) {
+                if (_Stats.hashed_passes & (1 << _Which)) {
+                    _Format_digest(_Stats.pass_digests[_Which], _Digest);
+                    _Append_line(_Text, "    pass %u: sha256 %s", static_cast<unsigned int>(_Which), _Digest);
+                }
+            }
+
+            if (_Job.settings.verification != verify_mode::none) {
+                if (_Stats.passes_verified == 0) { // nothing has been read back, do not imply otherwise
+                    _Append_line(_Text, "    verification: %s, not verified",
+                        verify_mode_name(_Job.settings.verification));
+                } else {
+                    _Append_line(_Text, "    verification: %s, %llu of %llu bytes, %llu mismatched blocks",
+                        verify_mode_name(_Job.settings.verification),
+                        static_cast<unsigned long long>(_Stats.bytes_verified),
+                        static_cast<unsigned long long>(_Stats.bytes_verifiable),
+                        static_cast<unsigned long long>(_Stats.mismatches));
+                }
+
+                if (_Stats.passes_unverified != 0) {
+                    _Append_line(_Text, "    not verified: %u passes", _Stats.passes_unverified);
+                }
+            }
+
+            _Report.append(_Text);
+        } catch (...) {
+            // the certificate could not be built, the report shows the file anyway
+        }
+    }
+} // namespace mjx
\ No newline at end of file
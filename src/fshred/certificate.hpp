@@ -0,0 +1,17 @@
+// certificate.hpp
+
+// Copyright (c) Mateusz Jandura. All rights reserved.
+// SPDX-License-Identifier: Apache-2.0
+
+#pragma once
+#ifndef _FSHRED_CERTIFICATE_HPP_
+#define _FSHRED_CERTIFICATE_HPP_
+#include <fshred/job.hpp>
+#include <fshred/report.hpp>
+
+namespace mjx {
+    // appends the erasure certificate of the finished job to the report
+    void print_certificate(shred_report& _Report, const shred_job& _Job, const shred_status _Status) noexcept;
+} // namespace mjx
+
+#endif // _FSHRED_CERTIFICATE_HPP_
\ No newline at end of file
@@ -0,0 +1,112 @@
+// controller.cpp
+
+// Copyright (c) Mateusz Jandura. All rights reserved.
+// SPDX-License-Identifier: Apache-2.0
+
+#include <algorithm>
+#include <fshred/controller.hpp>
+
+namespace mjx {
+    concurrency_listener::~concurrency_listener() noexcept {}
+
+    concurrency_controller::concurrency_controller(
+        const size_t _Initial, const size_t _Min, const size_t _Max) noexcept
+        : _Mylimit((::std::min)((::std::max)(_Initial, _Min), _Max)), _Mylistener(nullptr), _Mymtx(),
+        _Mystats{0}, _Mywindow_start(_Clock::now()), _Mywindow_bytes(0), _Mywindow_transfers(0),
+        _Mywindow_time(0), _Myholds(0) {
+        _Mystats.limit         = _Mylimit.load(::std::memory_order_relaxed);
+        _Mystats.min_limit     = _Min;
+        _Mystats.max_limit     = _Max;
+        _Mystats.last_decision = concurrency_decision::none;
+    }
+
+    concurrency_controller::~concurrency_controller() noexcept {}
+
+    bool concurrency_controller::_Evaluate(const double _Seconds) noexcept {
+        // Note: The controller looks for the knee of the throughput curve. While adding files raises
+        //       the throughput, the limit grows by one per window. An increase that does not pay off
+        //       is taken back and the limit is held for a while before probing again. The latency is
+        //       the time it takes to make a MiB durable, so transfers of any size can be compared.
+        //       A latency well above the best one seen, without any gain in throughput, means that
+        //       the device is congested, so the limit shrinks by a quarter.
+        const double _Throughput     = static_cast<double>(_Mywindow_bytes) / _Seconds;
+        const double _Latency        = ::std::chrono::duration<double>(_Mywindow_time).count()
+                                     * 1048576.0 / static_cast<double>(_Mywindow_bytes);
+        const double _Old_throughput = _Mystats.throughput;
+        const bool _Gained           = _Throughput > _Old_throughput * 1.05;
+        if (_Mystats.base_latency == 0.0 || _Latency < _Mystats.base_latency) {
+            _Mystats.base_latency = _Latency;
+        }
+
+        const size_t _Old_limit = _Mylimit.load(::std::memory_order_relaxed);
+        size_t _Limit           = _Old_limit;
+        if (_Latency > 2.0 * _Mystats.base_latency && !_Gained) { // congested
+            _Limit                 = (::std::max)(_Mystats.min_limit, _Limit * 3 / 4);
+            _Mystats.last_decision = concurrency_decision::decrease;
+            ++_Mystats.decreases;
+            _Myholds = 0;
+        } else if (_Mystats.last_decision == concurrency_decision::increase && !_Gained) { // knee reached
+            _Limit                 = (::std::max)(_Mystats.min_limit, _Limit - 1);
+            _Mystats.last_decision = concurrency_decision::hold;
+            _Myholds               = 1;
+        } else if (_Limit >= _Mystats.max_limit
+            || (_Mystats.last_decision == concurrency_decision::hold && _Myholds < _Probe_interval)) {
+            _Mystats.last_decision = concurrency_decision::hold;
+            ++_Myholds;
+        } else { // probe for more throughput
+            _Limit                 = _Limit + 1;
+            _Mystats.last_decision = concurrency_decision::increase;
+            ++_Mystats.increases;
+            _Myholds = 0;
+        }
+
+        _Mystats.limit      = _Limit;
+        _Mystats.throughput = _Throughput;
+        _Mystats.latency    = _Latency;
+        _Mylimit.store(_Limit, ::std::memory_order_relaxed);
+        return _Limit > _Old_limit;
+    }
+
+    size_t concurrency_controller::limit() const noexcept {
+        return _Mylimit.load(::std::memory_order_relaxed);
+    }
+
+    void concurrency_controller::attach_listener(concurrency_listener* const _Listener) noexcept {
+        _Mylistener = _Listener;
+    }
+
+    void concurrency_controller::record_transfer(
+        const uint64_t _Size, const ::std::chrono::steady_clock::duration _Time) noexcept {
+        if (_Size == 0) { // nothing has reached the device
+            return;
+        }
+
+        bool _Grown;
+        {
+            ::std::lock_guard<::std::mutex> _Guard(_Mymtx);
+            _Mywindow_bytes += _Size;
+            _Mywindow_time += _Time;
+            ++_Mywindow_transfers;
+
+            const _Clock::time_point _Now = _Clock::now();
+            if (_Now - _Mywindow_start < _Window_duration || _Mywindow_transfers < _Min_window_transfers) {
+                return;
+            }
+
+            _Grown              = _Evaluate(::std::chrono::duration<double>(_Now - _Mywindow_start).count());
+            _Mywindow_start     = _Now;
+            _Mywindow_bytes     = 0;
+            _Mywindow_transfers = 0;
+            _Mywindow_time      = _Clock::duration{0};
+        }
+
+        if (_Grown && _Mylistener) { // more files may run now
+            _Mylistener->limit_grown();
+        }
+    }
+
+    concurrency_stats concurrency_controller::stats() const noexcept {
+        ::std::lock_guard<::std::mutex> _Guard(_Mymtx);
+        return _Mystats;
+    }
+} // namespace mjx
\ No newline at end of file
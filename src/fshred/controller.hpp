@@ -0,0 +1,89 @@
+// controller.hpp
+
+// Copyright (c) Mateusz Jandura. All rights reserved.
+// SPDX-License-Identifier: Apache-2.0
+
+#pragma once
+#ifndef _FSHRED_CONTROLLER_HPP_
+#define _FSHRED_CONTROLLER_HPP_
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+
+namespace mjx {
+    enum class concurrency_decision : unsigned char {
+        none, // no window has been evaluated yet
+        increase, // throughput grew, more files are shredded at once
+        hold, // throughput stopped growing, the knee has been reached
+        decrease // latency grew without throughput, fewer files are shredded at once
+    };
+
+    struct concurrency_stats {
+        size_t limit; // current number of files shredded at once
+        size_t min_limit;
+        size_t max_limit;
+        double throughput; // bytes per second in the last window
+        double latency; // time to make a MiB durable in the last window, in seconds
+        double base_latency; // lowest time to make a MiB durable seen so far, in seconds
+        uint64_t increases; // number of additive increases
+        uint64_t decreases; // number of multiplicative decreases
+        concurrency_decision last_decision;
+    };
+
+    class concurrency_listener { // receives the changes of the limit
+    public:
+        virtual ~concurrency_listener() noexcept;
+
+        // called once the limit has grown, never while the controller is locked
+        virtual void limit_grown() noexcept = 0;
+    };
+
+    class concurrency_controller { // AIMD controller of the number of files shredded at once
+    public:
+        concurrency_controller(const size_t _Initial, const size_t _Min, const size_t _Max) noexcept;
+        ~concurrency_controller() noexcept;
+
+        concurrency_controller(const concurrency_controller&)            = delete;
+        concurrency_controller& operator=(const concurrency_controller&) = delete;
+
+        // returns the current number of files that may be shredded at once
+        size_t limit() const noexcept;
+
+        // assigns the listener notified when the limit grows, must outlive the controller
+        void attach_listener(concurrency_listener* const _Listener) noexcept;
+
+        // records data that has reached the device and the time spent writing and flushing it,
+        // re-evaluates the limit once per window
+        void record_transfer(
+            const uint64_t _Size, const ::std::chrono::steady_clock::duration _Time) noexcept;
+
+        // returns the current decisions and measurements
+        concurrency_stats stats() const noexcept;
+
+    private:
+        using _Clock = ::std::chrono::steady_clock;
+
+        // adjusts the limit based on the measurements of the finished window, returns true if it grew
+        bool _Evaluate(const double _Seconds) noexcept;
+
+        // Note: A transfer ends with a barrier, so there are far fewer of them than writes. Large files
+        //       report a transfer per checkpoint or pass, so a window may take longer than its duration.
+        static constexpr ::std::chrono::milliseconds _Window_duration{250};
+        static constexpr uint64_t _Min_window_transfers = 4;
+        static constexpr size_t _Probe_interval         = 8; // windows held before probing again
+
+        ::std::atomic<size_t> _Mylimit;
+        concurrency_listener* _Mylistener; // may be null
+        mutable ::std::mutex _Mymtx;
+        concurrency_stats _Mystats;
+        _Clock::time_point _Mywindow_start;
+        uint64_t _Mywindow_bytes;
+        uint64_t _Mywindow_transfers;
+        _Clock::duration _Mywindow_time; // time spent writing and flushing the data of the window
+        size_t _Myholds; // consecutive windows without a change
+    };
+} // namespace mjx
+
+#endif // _FSHRED_CONTROLLER_HPP_
\ No newline at end of file
@@ -0,0 +1,142 @@
+// device.cpp
+
+// Copyright (c) Mateusz Jandura. All rights reserved.
+// SPDX-License-Identifier: Apache-2.0
+
+#include <fshred/device.hpp>
+#include <fshred/utils.hpp>
+#include <mjstr/string.hpp>
+#include <winioctl.h> // include after <Windows.h>
+
+namespace mjx {
+    _Volume_handle::_Volume_handle(const file& _File, const DWORD _Access) noexcept
+        : _Myhandle(INVALID_HANDLE_VALUE) {
+        try {
+            _Myhandle = _Open(_File, _Access);
+        } catch (...) {
+            _Myhandle = INVALID_HANDLE_VALUE;
+        }
+    }
+
+    _Volume_handle::~_Volume_handle() noexcept {
+        if (_Myhandle != INVALID_HANDLE_VALUE) {
+            ::CloseHandle(_Myhandle);
+            _Myhandle = INVALID_HANDLE_VALUE;
+        }
+    }
+
+    inline bool _Query_guid_path(const file& _File, unicode_string& _Path) {
+        // Note: The path starts with the volume GUID, so it remains valid even if the volume
+        //       has no drive letter.
+        const HANDLE _Handle = _File.native_handle();
+        const DWORD _Size    = ::GetFinalPathNameByHandleW(_Handle, nullptr, 0, VOLUME_NAME_GUID);
+        if (_Size == 0) {
+            return false;
+        }
+
+        _Path.resize(static_cast<size_t>(_Size));
+        const DWORD _Length = ::GetFinalPathNameByHandleW(_Handle, _Path.data(), _Size, VOLUME_NAME_GUID);
+        if (_Length == 0 || _Length >= _Size) {
+            return false;
+        }
+
+        _Path.resize(static_cast<size_t>(_Length)); // discard the terminating null
+        return true;
+    }
+
+    HANDLE _Volume_handle::_Open(const file& _File, const DWORD _Access) {
+        unicode_string _Path;
+        if (!_Query_guid_path(_File, _Path)) {
+            return INVALID_HANDLE_VALUE;
+        }
+
+        // "\\?\Volume{GUID}\..." -> "\\?\Volume{GUID}", which refers to the volume itself
+        const size_t _Sep = _Path.view().find(L'\\', 4);
+        if (_Sep == unicode_string_view::npos) {
+            return INVALID_HANDLE_VALUE;
+        }
+
+        _Path.resize(_Sep);
+        return ::CreateFileW(
+            _Path.c_str(), _Access, FILE_SHARE_READ | FILE_SHARE_WRITE, nullptr, OPEN_EXISTING, 0, nullptr);
+    }
+
+    struct _Io_status_block { // IO_STATUS_BLOCK from <winternl.h>
+        union {
+            long _Status;
+            void* _Pointer;
+        };
+
+        ULONG_PTR _Information;
+    };
+
+    bool flush_file_data(const file& _File) noexcept {
+        return ::mjx::_Flush_file_data(_File.native_handle());
+    }
+
+    bool _Flush_file_data(const HANDLE _Handle) noexcept {
+        // Note: NtFlushBuffersFileEx() is available since Windows 8. FLUSH_FLAGS_FILE_DATA_ONLY makes
+        //       it write only the file data, like fdatasync() does. On older systems, the data is
+        //       written together with the metadata.
+        using _Fn_t = long(__stdcall*)(HANDLE, ULONG, void*, ULONG, _Io_status_block*);
+        static constexpr ULONG _Flush_flags_file_data_only = 0x0000'0001;
+        static _Fn_t _Func = _Load_symbol<_Fn_t>("ntdll.dll", "NtFlushBuffersFileEx"); // load once
+        if (_Func) {
+            _Io_status_block _Status = {};
+            return _Func(_Handle, _Flush_flags_file_data_only, nullptr, 0, &_Status) >= 0;
+        }
+
+        return ::FlushFileBuffers(_Handle) != 0;
+    }
+
+    bool flush_volume(const file& _File) noexcept {
+        // Note: Flushing a volume requires write access to it, which is only granted to administrators.
+        _Volume_handle _Volume(_File, GENERIC_WRITE);
+        return _Volume._Valid() && ::FlushFileBuffers(_Volume._Get()) != 0;
+    }
+
+    inline bool _Zeroes_in_place(const file& _File, const file_metadata& _Meta) noexcept {
+        // Note: On NTFS, zeroing a range of a regular file writes zeros to its clusters. Sparse and
+        //       compressed files have the range deallocated instead, and encrypted files are not
+        //       stored as plain data, so the old data could survive on the media.
+        if (!::mjx::has_plain_data(_Meta)) {
+            return false;
+        }
+
+        wchar_t _File_system[MAX_PATH + 1];
+        if (!::GetVolumeInformationByHandleW(
+            _File.native_handle(), nullptr, 0, nullptr, nullptr, nullptr, _File_system, MAX_PATH + 1)) {
+            return false;
+        }
+
+        return ::_wcsicmp(_File_system, L"NTFS") == 0;
+    }
+
+    bool zero_file_data(const file& _File, const file_metadata& _Meta) noexcept {
+        const uint64_t _Size = _Meta.size;
+        if (_Size == 0) { // no data to overwrite, do nothing
+            return true;
+        }
+
+        if (!_Zeroes_in_place(_File, _Meta)) {
+            return false;
+        }
+
+        FILE_ZERO_DATA_INFORMATION _Range;
+        _Range.FileOffset.QuadPart      = 0;
+        _Range.BeyondFinalZero.QuadPart = static_cast<LONGLONG>(_Size);
+        DWORD _Bytes                    = 0;
+        return ::DeviceIoControl(_File.native_handle(), FSCTL_SET_ZERO_DATA,
+            &_Range, sizeof(_Range), nullptr, 0, &_Bytes, nullptr) != 0;
+    }
+
+    bool delete_file_on_close(const file& _File, const bool _Delete) noexcept {
+        // Note: Unlike the plain disposition, the extended one can also clear the deletion requested
+        //       by FILE_FLAG_DELETE_ON_CLOSE. It is supported since Windows 10, version 1607.
+        FILE_DISPOSITION_INFO_EX _Info;
+        _Info.Flags = FILE_DISPOSITION_FLAG_ON_CLOSE
+            | (_Delete ? FILE_DISPOSITION_FLAG_DELETE : FILE_DISPOSITION_FLAG_DO_NOT_DELETE);
+        return ::SetFileInformationByHandle(
+            _File.native_handle(), FileDispositionInfoEx, &_Info, sizeof(_Info)) != 0;
+    }
+} // namespace mjx
\ No newline at end of file
@@ -0,0 +1,53 @@
+// device.hpp
+
+// Copyright (c) Mateusz Jandura. All rights reserved.
+// SPDX-License-Identifier: Apache-2.0
+
+#pragma once
+#ifndef _FSHRED_DEVICE_HPP_
+#define _FSHRED_DEVICE_HPP_
+#include <fshred/identity.hpp>
+#include <fshred/tinywin.hpp>
+#include <mjfs/file.hpp>
+
+namespace mjx {
+    class _Volume_handle { // handle to the volume that stores a file
+    public:
+        _Volume_handle(const file& _File, const DWORD _Access) noexcept;
+        ~_Volume_handle() noexcept;
+
+        _Volume_handle(const _Volume_handle&)            = delete;
+        _Volume_handle& operator=(const _Volume_handle&) = delete;
+
+        bool _Valid() const noexcept {
+            return _Myhandle != INVALID_HANDLE_VALUE;
+        }
+
+        HANDLE _Get() const noexcept {
+            return _Myhandle;
+        }
+
+    private:
+        // opens the volume, returns INVALID_HANDLE_VALUE on failure
+        static HANDLE _Open(const file& _File, const DWORD _Access);
+
+        HANDLE _Myhandle;
+    };
+
+    // writes the file data to the device, skips the metadata if possible
+    bool flush_file_data(const file& _File) noexcept;
+
+    // writes the data of the file opened by the handle to the device, skips the metadata if possible
+    bool _Flush_file_data(const HANDLE _Handle) noexcept;
+
+    // writes the data of all files on the volume that stores the file to the device
+    bool flush_volume(const file& _File) noexcept;
+
+    // lets the file system overwrite all data with zeros, fails if it would not overwrite the clusters
+    bool zero_file_data(const file& _File, const file_metadata& _Meta) noexcept;
+
+    // changes whether the file is deleted once its last handle is closed, requires the delete access
+    bool delete_file_on_close(const file& _File, const bool _Delete) noexcept;
+} // namespace mjx
+
+#endif // _FSHRED_DEVICE_HPP_
\ No newline at end of file
@@ -0,0 +1,57 @@
+// fill.cpp
+
+// Copyright (c) Mateusz Jandura. All rights reserved.
+// SPDX-License-Identifier: Apache-2.0
+
+#include <algorithm>
+#include <cstring>
+#include <fshred/fill.hpp>
+#include <fshred/kernels.hpp>
+#include <fshred/random.hpp>
+
+namespace mjx {
+    void fill_constant(byte_t* const _Buf, const size_t _Size, const byte_t _Val) noexcept {
+        if (_Size < non_temporal_fill_threshold) { // keep the buffer in the caches
+            ::memset(_Buf, _Val, _Size);
+        } else {
+            ::mjx::fill_non_temporal(_Buf, _Size, _Val);
+        }
+    }
+
+    bool fill_random(byte_t* const _Buf, const size_t _Size) noexcept {
+        if (_Size < non_temporal_fill_threshold || ::mjx::bound_simd_level() == simd_level::none) {
+            return ::mjx::fill_with_cached_random_bytes(_Buf, _Size); // keep the buffer in the caches
+        }
+
+        // Note: The random generator writes through the caches, so the random bytes are generated
+        //       into a small buffer, which remains in the caches, and then streamed to the target.
+        byte_t _Scratch[16384];
+        size_t _Chunk_size;
+        for (size_t _Off = 0; _Off < _Size; _Off += _Chunk_size) {
+            _Chunk_size = (::std::min)(sizeof(_Scratch), _Size - _Off);
+            if (!::mjx::fill_with_cached_random_bytes(_Scratch, _Chunk_size)) {
+                return false;
+            }
+
+            ::mjx::copy_non_temporal(_Buf + _Off, _Scratch, _Chunk_size);
+        }
+
+        return true;
+    }
+
+    void fill_keystream(const random_stream& _Stream, const uint64_t _Nonce, const uint64_t _Offset,
+        byte_t* const _Buf, const size_t _Size) noexcept {
+        if (_Size < non_temporal_fill_threshold || ::mjx::bound_simd_level() == simd_level::none) {
+            _Stream.generate(_Nonce, _Offset, _Buf, _Size); // keep the buffer in the caches
+            return;
+        }
+
+        byte_t _Scratch[16384]; // see fill_random()
+        size_t _Chunk_size;
+        for (size_t _Off = 0; _Off < _Size; _Off += _Chunk_size) {
+            _Chunk_size = (::std::min)(sizeof(_Scratch), _Size - _Off);
+            _Stream.generate(_Nonce, _Offset + _Off, _Scratch, _Chunk_size);
+            ::mjx::copy_non_temporal(_Buf + _Off, _Scratch, _Chunk_size);
+        }
+    }
+} // namespace mjx
\ No newline at end of file
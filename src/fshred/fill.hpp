@@ -0,0 +1,32 @@
+// fill.hpp
+
+// Copyright (c) Mateusz Jandura. All rights reserved.
+// SPDX-License-Identifier: Apache-2.0
+
+#pragma once
+#ifndef _FSHRED_FILL_HPP_
+#define _FSHRED_FILL_HPP_
+#include <cstddef>
+#include <cstdint>
+#include <fshred/random.hpp>
+#include <mjstr/char_traits.hpp>
+
+namespace mjx {
+    // Note: Pattern data is written once and then sent to the device, so keeping it in the CPU caches
+    //       only evicts the data of other threads. Buffers of at least this size are filled with
+    //       non-temporal stores that bypass the caches. Smaller buffers are reused for many writes,
+    //       so they are better kept in the caches.
+    inline constexpr size_t non_temporal_fill_threshold = 512 * 1024;
+
+    // fills the buffer with the value
+    void fill_constant(byte_t* const _Buf, const size_t _Size, const byte_t _Val) noexcept;
+
+    // fills the buffer with random bytes
+    bool fill_random(byte_t* const _Buf, const size_t _Size) noexcept;
+
+    // fills the buffer with the bytes of the stream at the offset
+    void fill_keystream(const random_stream& _Stream, const uint64_t _Nonce, const uint64_t _Offset,
+        byte_t* const _Buf, const size_t _Size) noexcept;
+} // namespace mjx
+
+#endif // _FSHRED_FILL_HPP_
\ No newline at end of file
@@ -0,0 +1,112 @@
+// hash.cpp
+
+// Copyright (c) Mateusz Jandura. All rights reserved.
+// SPDX-License-Identifier: Apache-2.0
+
+#include <algorithm>
+#include <fshred/hash.hpp>
+#include <fshred/tinywin.hpp>
+#include <fshred/utils.hpp>
+#include <bcrypt.h> // include after <Windows.h>
+
+namespace mjx {
+    struct _Hash_api { // hashing functions of Bcrypt.dll
+        decltype(&::BCryptCreateHash) _Create;
+        decltype(&::BCryptHashData) _Update;
+        decltype(&::BCryptFinishHash) _Finish;
+        decltype(&::BCryptDestroyHash) _Destroy;
+        BCRYPT_ALG_HANDLE _Provider; // SHA-256 provider, null if not available
+    };
+
+    inline _Hash_api _Load_hash_api() noexcept {
+        // Note: Unlike a single symbol, the hashing functions are used for the whole lifetime
+        //       of the process, so the library and the provider are kept open until it exits.
+        //       The system implementation uses the SHA extensions of the CPU if available.
+        static _Library_handle _Lib("Bcrypt.dll");
+        _Hash_api _Api = {nullptr};
+        if (!_Lib._Valid()) {
+            return _Api;
+        }
+
+        using _Open_fn = decltype(&::BCryptOpenAlgorithmProvider);
+        const _Open_fn _Open = _Load_symbol<_Open_fn>(_Lib._Get(), "BCryptOpenAlgorithmProvider");
+        _Api._Create         = _Load_symbol<decltype(_Api._Create)>(_Lib._Get(), "BCryptCreateHash");
+        _Api._Update         = _Load_symbol<decltype(_Api._Update)>(_Lib._Get(), "BCryptHashData");
+        _Api._Finish         = _Load_symbol<decltype(_Api._Finish)>(_Lib._Get(), "BCryptFinishHash");
+        _Api._Destroy        = _Load_symbol<decltype(_Api._Destroy)>(_Lib._Get(), "BCryptDestroyHash");
+        if (!_Open || !_Api._Create || !_Api._Update || !_Api._Finish || !_Api._Destroy
+            || _Open(&_Api._Provider, BCRYPT_SHA256_ALGORITHM, nullptr, 0) != 0) {
+            _Api._Provider = nullptr;
+        }
+
+        return _Api;
+    }
+
+    inline const _Hash_api& _Get_hash_api() noexcept {
+        static const _Hash_api _Api = _Load_hash_api(); // load once
+        return _Api;
+    }
+
+    sha256_hash::sha256_hash() noexcept : _Myhandle(nullptr) {}
+
+    sha256_hash::~sha256_hash() noexcept {
+        _Destroy();
+    }
+
+    void sha256_hash::_Destroy() noexcept {
+        if (_Myhandle) {
+            _Get_hash_api()._Destroy(_Myhandle);
+            _Myhandle = nullptr;
+        }
+    }
+
+    bool sha256_hash::active() const noexcept {
+        return _Myhandle != nullptr;
+    }
+
+    bool sha256_hash::start() noexcept {
+        _Destroy();
+        const _Hash_api& _Api = _Get_hash_api();
+        if (!_Api._Provider) { // SHA-256 not available
+            return false;
+        }
+
+        // the system allocates the hash object
+        if (_Api._Create(_Api._Provider, &_Myhandle, nullptr, 0, nullptr, 0, 0) != 0) {
+            _Myhandle = nullptr;
+            return false;
+        }
+
+        return true;
+    }
+
+    bool sha256_hash::update(const byte_t* const _Data, const size_t _Size) noexcept {
+        if (!_Myhandle) {
+            return false;
+        }
+
+        // Note: The chunks written by the shredder never exceed 4 GiB, but larger data is split anyway,
+        //       since BCryptHashData() accepts a 32-bit size.
+        static constexpr size_t _Max_size = 0x8000'0000;
+        size_t _Chunk_size;
+        for (size_t _Off = 0; _Off < _Size; _Off += _Chunk_size) {
+            _Chunk_size = (::std::min)(_Max_size, _Size - _Off);
+            if (_Get_hash_api()._Update(_Myhandle, const_cast<PUCHAR>(_Data + _Off),
+                static_cast<unsigned long>(_Chunk_size), 0) != 0) {
+                return false;
+            }
+        }
+
+        return true;
+    }
+
+    bool sha256_hash::finish(byte_t (&_Digest)[sha256_digest_size]) noexcept {
+        if (!_Myhandle) {
+            return false;
+        }
+
+        const bool _Result = _Get_hash_api()._Finish(_Myhandle, _Digest, sha256_digest_size, 0) == 0;
+        _Destroy();
+        return _Result;
+    }
+} // namespace mjx
\ No newline at end of file
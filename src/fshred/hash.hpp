@@ -0,0 +1,43 @@
+// hash.hpp
+
+// Copyright (c) Mateusz Jandura. All rights reserved.
+// SPDX-License-Identifier: Apache-2.0
+
+#pragma once
+#ifndef _FSHRED_HASH_HPP_
+#define _FSHRED_HASH_HPP_
+#include <cstddef>
+#include <mjstr/char_traits.hpp>
+
+namespace mjx {
+    inline constexpr size_t sha256_digest_size = 32;
+
+    class sha256_hash { // incremental SHA-256 of a stream, computed by the system
+    public:
+        sha256_hash() noexcept;
+        ~sha256_hash() noexcept;
+
+        sha256_hash(const sha256_hash&)            = delete;
+        sha256_hash& operator=(const sha256_hash&) = delete;
+
+        // checks whether the hash has been started
+        bool active() const noexcept;
+
+        // starts a new hash, discards the previous one
+        bool start() noexcept;
+
+        // appends the data to the hashed stream
+        bool update(const byte_t* const _Data, const size_t _Size) noexcept;
+
+        // finishes the hash and writes its digest, the hash must be started again before the next use
+        bool finish(byte_t (&_Digest)[sha256_digest_size]) noexcept;
+
+    private:
+        // releases the hash object
+        void _Destroy() noexcept;
+
+        void* _Myhandle; // BCRYPT_HASH_HANDLE, null if not started
+    };
+} // namespace mjx
+
+#endif // _FSHRED_HASH_HPP_
\ No newline at end of file
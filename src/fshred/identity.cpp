@@ -0,0 +1,113 @@
+// identity.cpp
+
+// Copyright (c) Mateusz Jandura. All rights reserved.
+// SPDX-License-Identifier: Apache-2.0
+
+#include <fshred/identity.hpp>
+#include <fshred/tinywin.hpp>
+
+namespace mjx {
+    bool operator==(const file_id& _Left, const file_id& _Right) noexcept {
+        return _Left.volume == _Right.volume && _Left.index == _Right.index;
+    }
+
+    bool operator!=(const file_id& _Left, const file_id& _Right) noexcept {
+        return !(_Left == _Right);
+    }
+
+    bool query_file_id(const file& _File, file_id& _Id) noexcept {
+        file_metadata _Meta;
+        if (!::mjx::query_file_metadata(_File, _Meta)) {
+            return false;
+        }
+
+        _Id = _Meta.id;
+        return true;
+    }
+
+    bool query_file_metadata(const file& _File, file_metadata& _Meta) noexcept {
+        // Note: A single query returns everything needed to identify, schedule and shred the file.
+        //       The size does not change once the file is opened without write sharing, so it is
+        //       not queried again before every pass.
+        BY_HANDLE_FILE_INFORMATION _Info;
+        if (!::GetFileInformationByHandle(_File.native_handle(), &_Info)) {
+            _Meta.id         = file_id{0, 0};
+            _Meta.size       = _File.size();
+            _Meta.attributes = INVALID_FILE_ATTRIBUTES; // assume the worst
+            _Meta.links      = 1;
+            _Meta.last_write = 0;
+            return false;
+        }
+
+        _Meta.id.volume  = static_cast<uint32_t>(_Info.dwVolumeSerialNumber);
+        _Meta.id.index   = (static_cast<uint64_t>(_Info.nFileIndexHigh) << 32) | _Info.nFileIndexLow;
+        _Meta.size       = (static_cast<uint64_t>(_Info.nFileSizeHigh) << 32) | _Info.nFileSizeLow;
+        _Meta.attributes = static_cast<uint32_t>(_Info.dwFileAttributes);
+        _Meta.links      = static_cast<uint32_t>(_Info.nNumberOfLinks);
+        _Meta.last_write = (static_cast<uint64_t>(_Info.ftLastWriteTime.dwHighDateTime) << 32)
+                         | _Info.ftLastWriteTime.dwLowDateTime;
+        return true;
+    }
+
+    bool has_plain_data(const file_metadata& _Meta) noexcept {
+        return (_Meta.attributes
+            & (FILE_ATTRIBUTE_SPARSE_FILE | FILE_ATTRIBUTE_COMPRESSED | FILE_ATTRIBUTE_ENCRYPTED)) == 0;
+    }
+
+    size_t _File_id_hash::operator()(const file_id& _Id) const noexcept {
+        // Note: File indexes are mostly sequential, so mix the volume into the upper bits and
+        //       scramble the result to spread consecutive indexes over the buckets.
+        uint64_t _Val = _Id.index ^ (static_cast<uint64_t>(_Id.volume) << 32);
+        _Val ^= _Val >> 33;
+        _Val *= 0xFF51'AFD7'ED55'8CCDULL;
+        _Val ^= _Val >> 33;
+        return static_cast<size_t>(_Val);
+    }
+
+    file_id_index::file_id_index() noexcept : _Myslots(), _Mysize(0) {}
+
+    file_id_index::~file_id_index() noexcept {}
+
+    void file_id_index::_Rehash(const size_t _New_capacity) {
+        ::std::vector<file_id> _Old_slots(_New_capacity, file_id{0, 0});
+        _Old_slots.swap(_Myslots);
+        const size_t _Mask = _New_capacity - 1;
+        size_t _Idx;
+        for (const file_id& _Id : _Old_slots) {
+            if (_Id == file_id{0, 0}) { // empty slot
+                continue;
+            }
+
+            _Idx = _File_id_hash{}(_Id) & _Mask;
+            while (_Myslots[_Idx] != file_id{0, 0}) { // take the next free slot
+                _Idx = (_Idx + 1) & _Mask;
+            }
+
+            _Myslots[_Idx] = _Id;
+        }
+    }
+
+    bool file_id_index::insert(const file_id& _Id) {
+        if (_Id == file_id{0, 0}) { // not identified, cannot be recognized later
+            return true;
+        }
+
+        if ((_Mysize + 1) * 4 > _Myslots.size() * 3) { // keep the table at most three quarters full
+            _Rehash(_Myslots.empty() ? _Initial_capacity : _Myslots.size() * 2);
+        }
+
+        const size_t _Mask = _Myslots.size() - 1;
+        for (size_t _Idx = _File_id_hash{}(_Id) & _Mask;; _Idx = (_Idx + 1) & _Mask) {
+            file_id& _Slot = _Myslots[_Idx];
+            if (_Slot == _Id) { // already present
+                return false;
+            }
+
+            if (_Slot == file_id{0, 0}) {
+                _Slot = _Id;
+                ++_Mysize;
+                return true;
+            }
+        }
+    }
+} // namespace mjx
\ No newline at end of file
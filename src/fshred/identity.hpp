@@ -0,0 +1,67 @@
+// identity.hpp
+
+// Copyright (c) Mateusz Jandura. All rights reserved.
+// SPDX-License-Identifier: Apache-2.0
+
+#pragma once
+#ifndef _FSHRED_IDENTITY_HPP_
+#define _FSHRED_IDENTITY_HPP_
+#include <cstddef>
+#include <cstdint>
+#include <mjfs/file.hpp>
+#include <vector>
+
+namespace mjx {
+    struct file_id { // identifies a file regardless of the link used to reach it
+        uint32_t volume; // volume serial number
+        uint64_t index; // file index on the volume
+    };
+
+    bool operator==(const file_id& _Left, const file_id& _Right) noexcept;
+    bool operator!=(const file_id& _Left, const file_id& _Right) noexcept;
+
+    struct file_metadata { // attributes of an opened file, queried once and carried with the file
+        file_id id;
+        uint64_t size;
+        uint32_t attributes; // FILE_ATTRIBUTE_* flags
+        uint32_t links; // number of hard links
+        uint64_t last_write; // last write time, a FILETIME
+    };
+
+    // retrieves the identifier of the opened file
+    bool query_file_id(const file& _File, file_id& _Id) noexcept;
+
+    // retrieves the identifier, the size, the attributes, the number of hard links and the last write time
+    // with a single query, if it fails, only the size is known and the attributes are INVALID_FILE_ATTRIBUTES
+    bool query_file_metadata(const file& _File, file_metadata& _Meta) noexcept;
+
+    // checks whether the data is stored in place, so neither sparse, compressed nor encrypted
+    bool has_plain_data(const file_metadata& _Meta) noexcept;
+
+    struct _File_id_hash {
+        size_t operator()(const file_id& _Id) const noexcept;
+    };
+
+    class file_id_index { // remembers which files have already been shredded
+    public:
+        file_id_index() noexcept;
+        ~file_id_index() noexcept;
+
+        // inserts a new identifier, returns false if it was already present
+        bool insert(const file_id& _Id);
+
+    private:
+        // moves the identifiers to a table with the specified number of slots, a power of two
+        void _Rehash(const size_t _New_capacity);
+
+        // Note: Every file is remembered, so that a file reached through overlapping targets, a repeated
+        //       path or another link is shredded only once. The identifiers are stored in a flat table
+        //       with open addressing instead of a node per file, which takes 16 bytes per slot.
+        static constexpr size_t _Initial_capacity = 1024;
+
+        ::std::vector<file_id> _Myslots; // a zero identifier marks an empty slot
+        size_t _Mysize;
+    };
+} // namespace mjx
+
+#endif // _FSHRED_IDENTITY_HPP_
\ No newline at end of file
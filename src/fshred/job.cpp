@@ -0,0 +1,257 @@
+// job.cpp
+
+// Copyright (c) Mateusz Jandura. All rights reserved.
+// SPDX-License-Identifier: Apache-2.0
+
+#include <chrono>
+#include <fshred/device.hpp>
+#include <fshred/job.hpp>
+#include <fshred/tinywin.hpp>
+#include <limits>
+#include <mjfs/status.hpp>
+#include <utility>
+
+namespace mjx {
+    inline constexpr file_flag _Write_through_flag = static_cast<file_flag>(FILE_FLAG_WRITE_THROUGH);
+    inline constexpr file_flag _No_buffering_flag  = static_cast<file_flag>(FILE_FLAG_NO_BUFFERING);
+
+    shred_job::shred_job() noexcept
+        : target(), handle(), delete_after_shredding(false),
+        min_mapped_size((::std::numeric_limits<uint64_t>::max)()), settings(::mjx::default_shred_settings()),
+        stats{shred_engine::buffered, false, 0}, journal(nullptr), journal_slot(shred_journal::npos),
+        metadata{file_id{0, 0}, 0, 0, 0, 0} {}
+
+    shred_job::shred_job(shred_job&& _Other) noexcept
+        : target(::std::move(_Other.target)), handle(::std::move(_Other.handle)),
+        delete_after_shredding(_Other.delete_after_shredding), min_mapped_size(_Other.min_mapped_size),
+        settings(_Other.settings),
+        stats(_Other.stats), journal(_Other.journal), journal_slot(_Other.journal_slot),
+        metadata(_Other.metadata) {}
+
+    shred_job::~shred_job() noexcept {}
+
+    shred_job& shred_job::operator=(shred_job&& _Other) noexcept {
+        if (this != &_Other) {
+            target                 = ::std::move(_Other.target);
+            handle                 = ::std::move(_Other.handle);
+            delete_after_shredding = _Other.delete_after_shredding;
+            min_mapped_size        = _Other.min_mapped_size;
+            settings               = _Other.settings;
+            stats                  = _Other.stats;
+            journal                = _Other.journal;
+            journal_slot           = _Other.journal_slot;
+            metadata               = _Other.metadata;
+        }
+
+        return *this;
+    }
+
+    const char* shred_status_name(const shred_status _Status) noexcept {
+        switch (_Status) {
+        case shred_status::success:
+            return "shredded";
+        case shred_status::bad_file:
+            return "cannot open";
+        case shred_status::cannot_shred_file:
+            return "cannot shred";
+        case shred_status::cannot_delete_file:
+            return "cannot delete";
+        case shred_status::cannot_write_report:
+            return "cannot write report";
+        case shred_status::verification_failed:
+            return "verification failed";
+        case shred_status::cannot_open_journal:
+            return "cannot open journal";
+        case shred_status::cancelled:
+            return "cancelled";
+        case shred_status::cannot_open_manifest:
+            return "cannot open manifest";
+        case shred_status::cannot_allocate_buffers:
+            return "cannot allocate buffers";
+        default:
+            return "unknown";
+        }
+    }
+
+    const char* shred_method_name(const shred_method _Method) noexcept {
+        switch (_Method) {
+        case shred_method::dod_5220_22_m_ece:
+            return "DoD 5220.22-M (ECE)";
+        case shred_method::nist_800_88_clear:
+            return "NIST 800-88 Clear";
+        default:
+            return "unknown";
+        }
+    }
+
+    const char* shred_engine_name(const shred_engine _Engine) noexcept {
+        switch (_Engine) {
+        case shred_engine::buffered:
+            return "buffered";
+        case shred_engine::mapped:
+            return "mapped";
+        default:
+            return "unknown";
+        }
+    }
+
+    const char* verify_mode_name(const verify_mode _Mode) noexcept {
+        switch (_Mode) {
+        case verify_mode::none:
+            return "not verified";
+        case verify_mode::final_pass:
+            return "final pass verified";
+        case verify_mode::every_pass:
+            return "every pass verified";
+        default:
+            return "unknown";
+        }
+    }
+
+    const char* durability_policy_name(const durability_policy _Policy) noexcept {
+        switch (_Policy) {
+        case durability_policy::flush_per_pass:
+            return "flush per pass";
+        case durability_policy::data_flush_per_pass:
+            return "data flush per pass";
+        case durability_policy::write_through:
+            return "write-through";
+        case durability_policy::flush_per_group:
+            return "flush per group";
+        default:
+            return "unknown";
+        }
+    }
+
+    shred_status open_shred_job(shred_job& _Job) noexcept {
+        // Note: A mapping of the file requires read access as well. If it cannot be granted,
+        //       the file is shredded through the buffered engine instead. The mapped pages are
+        //       the system cache, so a file that bypasses the cache is never mapped.
+        const bool _Mappable = !_Job.settings.bypass_cache
+            && _Job.min_mapped_size != (::std::numeric_limits<uint64_t>::max)();
+        const bool _Verified = _Job.settings.verification != verify_mode::none;
+        file_access _Access;
+        file_flag _Flags;
+        if (_Job.delete_after_shredding) { // request all access
+            _Access = file_access::all;
+            _Flags  = file_flag::delete_on_close;
+        } else if (_Mappable) { // request read-write access
+            _Access = file_access::read | file_access::write;
+            _Flags  = file_flag::none;
+        } else { // request write-only access
+            _Access = file_access::write;
+            _Flags  = file_flag::none;
+        }
+
+        if (_Job.settings.durability == durability_policy::write_through) {
+            _Flags |= _Write_through_flag;
+        }
+
+        if (_Job.settings.bypass_cache) {
+            _Flags |= _No_buffering_flag;
+        }
+
+        // Note: The verification reads the file back through a second handle, which the file must
+        //       be shared for. Other processes may then read the file as well, but not write it.
+        const file_share _Share = _Verified ? file_share::read : file_share::none;
+        if (!_Job.handle.open(_Job.target, _Access, _Share, _Flags)
+            && _Access != file_access::write) { // try to open with write-only access
+            _Job.handle.open(_Job.target, file_access::write, _Share, _Flags);
+        }
+
+        if (!_Job.handle.is_open()) { // could not grant the minimum required access, break
+            if (_Job.journal) {
+                _Job.journal->finish(
+                    _Job.journal_slot, shred_status::bad_file, file_metadata{file_id{0, 0}, 0, 0, 0, 0});
+            }
+
+            return shred_status::bad_file;
+        }
+
+        // Note: The metadata is queried once the file cannot be written by others anymore, the shredder
+        //       then relies on it instead of querying the file before every pass.
+        ::mjx::query_file_metadata(_Job.handle, _Job.metadata);
+        if (_Mappable && _Job.metadata.size >= _Job.min_mapped_size) {
+            _Job.settings.engine = shred_engine::mapped;
+        }
+
+        return shred_status::success;
+    }
+
+    bool overwrite_job_data(shred_job& _Job, const shred_context& _Context) noexcept {
+        shred_context _Job_context = _Context;
+        _Job_context.settings      = _Job.settings;
+        _Job_context.stats         = &_Job.stats;
+        _Job_context.journal       = _Job.journal;
+        _Job_context.journal_slot  = _Job.journal_slot;
+        _Job_context.metadata      = _Job.metadata.links != 0 ? &_Job.metadata : nullptr; // queried if not
+
+        // Note: A file opened for deletion would be deleted with its data only partly overwritten
+        //       if it was stopped. Its deletion is called off until the data has been overwritten.
+        //       If that is not possible, the file cannot be stopped.
+        const bool _Postponed = _Job.delete_after_shredding && _Context.cancel
+            && ::mjx::delete_file_on_close(_Job.handle, false);
+        if (_Job.delete_after_shredding && !_Postponed) {
+            _Job_context.cancel = nullptr;
+        }
+
+        _File_shredder _Shredder(_Job.handle, _Job_context);
+        _Job.stats.started      = ::std::chrono::system_clock::now();
+        const bool _Overwritten = _Shredder._Shred();
+        if (_Overwritten && _Postponed) { // a failure is reported once the file turns out to still exist
+            ::mjx::delete_file_on_close(_Job.handle, true);
+        }
+
+        return _Overwritten;
+    }
+
+    inline shred_status _Close_job(shred_job& _Job, const bool _Overwritten) {
+        // Note: The file must be truncated only after the overwritten data has been made durable,
+        //       otherwise the cached data could be discarded before ever reaching the device.
+        const bool _Shredded = _Overwritten && _Job.handle.resize(0);
+        _Job.handle.close(); // closes and possibly deletes the file
+        _Job.stats.finished = ::std::chrono::system_clock::now();
+        if (!_Shredded) { // a mismatch and a stop are reported separately from a failed write
+            if (_Job.stats.cancelled) {
+                return shred_status::cancelled;
+            }
+
+            return _Job.stats.mismatches > 0
+                ? shred_status::verification_failed : shred_status::cannot_shred_file;
+        }
+
+        // Note: At this step, the file should be closed and, if the caller specified a special flag,
+        //       deleted. Deletion of the file should be handled automatically based on the provided
+        //       flags, so it is valid to check whether the file still exists at this point.
+        if (_Job.delete_after_shredding && ::mjx::exists(_Job.target)) {
+            return shred_status::cannot_delete_file;
+        }
+
+        return shred_status::success;
+    }
+
+    inline file_metadata _Query_remains(const path& _Target) {
+        // Note: The last write time is only final once the file has been closed, so the file is opened
+        //       again. A deleted file leaves nothing behind.
+        file_metadata _Meta{file_id{0, 0}, 0, 0, 0, 0};
+        const file _Probe(_Target, file_access::none, file_share::all);
+        if (_Probe.is_open() && !::mjx::query_file_metadata(_Probe, _Meta)) {
+            _Meta = file_metadata{file_id{0, 0}, 0, 0, 0, 0};
+        }
+
+        return _Meta;
+    }
+
+    shred_status finish_shred_job(shred_job& _Job, const bool _Overwritten) {
+        const shred_status _Status = ::mjx::_Close_job(_Job, _Overwritten);
+        if (_Job.journal) { // a later run skips a shredded file, even if it could not be deleted
+            _Job.journal->finish(_Job.journal_slot, _Status, ::mjx::_Query_remains(_Job.target));
+        }
+
+        return _Status;
+    }
+
+    shred_status run_shred_job(shred_job& _Job, const shred_context& _Context) {
+        return finish_shred_job(_Job, overwrite_job_data(_Job, _Context));
+    }
+} // namespace mjx
\ No newline at end of file
@@ -0,0 +1,79 @@
+// job.hpp
+
+// Copyright (c) Mateusz Jandura. All rights reserved.
+// SPDX-License-Identifier: Apache-2.0
+
+#pragma once
+#ifndef _FSHRED_JOB_HPP_
+#define _FSHRED_JOB_HPP_
+#include <cstdint>
+#include <fshred/shredder.hpp>
+#include <mjfs/file.hpp>
+#include <mjfs/path.hpp>
+
+namespace mjx {
+    enum class shred_status : unsigned char {
+        success,
+        bad_file,
+        cannot_shred_file,
+        cannot_delete_file,
+        cannot_write_report,
+        verification_failed,
+        cannot_open_journal,
+        cancelled,
+        cannot_open_manifest,
+        cannot_allocate_buffers
+    };
+
+    class shred_job { // single file waiting to be shredded
+    public:
+        path target;
+        file handle; // opened by the worker right before the file is shredded
+        bool delete_after_shredding;
+        uint64_t min_mapped_size; // the file is mapped if it has at least this size, the maximum if never
+        shred_settings settings;
+        shred_stats stats;
+        shred_progress* journal; // records the progress of the file, may be null
+        size_t journal_slot; // entry of the file in the journal
+        file_metadata metadata; // queried once the file has been opened, no links if it has not been
+
+        shred_job() noexcept;
+        shred_job(shred_job&& _Other) noexcept;
+        ~shred_job() noexcept;
+
+        shred_job& operator=(shred_job&& _Other) noexcept;
+
+        shred_job(const shred_job&)            = delete;
+        shred_job& operator=(const shred_job&) = delete;
+    };
+
+    // returns the name of the status, used in reports
+    const char* shred_status_name(const shred_status _Status) noexcept;
+
+    // returns the name of the method, used in reports
+    const char* shred_method_name(const shred_method _Method) noexcept;
+
+    // returns the name of the engine, used in reports
+    const char* shred_engine_name(const shred_engine _Engine) noexcept;
+
+    // returns the name of the verification mode, used in reports
+    const char* verify_mode_name(const verify_mode _Mode) noexcept;
+
+    // returns the name of the durability policy, used in reports
+    const char* durability_policy_name(const durability_policy _Policy) noexcept;
+
+    // opens the file with the access the job needs and queries its metadata
+    shred_status open_shred_job(shred_job& _Job) noexcept;
+
+    // overwrites the file data, the file remains open
+    bool overwrite_job_data(shred_job& _Job, const shred_context& _Context) noexcept;
+
+    // truncates and closes the overwritten file, verifies that it has been deleted if requested,
+    // marks the file as completed in the journal
+    shred_status finish_shred_job(shred_job& _Job, const bool _Overwritten);
+
+    // shreds the file, closes it and verifies that it has been deleted if requested
+    shred_status run_shred_job(shred_job& _Job, const shred_context& _Context);
+} // namespace mjx
+
+#endif // _FSHRED_JOB_HPP_
\ No newline at end of file
@@ -0,0 +1,230 @@
+// journal.cpp
+
+// Copyright (c) Mateusz Jandura. All rights reserved.
+// SPDX-License-Identifier: Apache-2.0
+
+#include <cstring>
+#include <fshred/job.hpp>
+#include <fshred/journal.hpp>
+#include <fshred/tinywin.hpp>
+#include <mjfs/status.hpp>
+#include <mutex>
+#include <utility>
+
+namespace mjx {
+    bool is_completed(const journal_entry& _Entry, const file_metadata& _Meta) noexcept {
+        // Note: A shredded file is left empty. If it holds data again, or it has been written since,
+        //       the file has been reused and its new data must be shredded as well.
+        return _Entry.state == journal_state::completed && _Entry.size == 0 && _Meta.size == 0
+            && _Entry.last_write == _Meta.last_write;
+    }
+
+    shred_progress::~shred_progress() noexcept {}
+
+    bool shred_progress::_Is_shredded(const shred_status _Status) noexcept {
+        switch (_Status) {
+        case shred_status::success:
+        case shred_status::cannot_delete_file: // overwritten and truncated, but not deleted
+            return true;
+        default:
+            return false;
+        }
+    }
+
+    shred_journal::shred_journal() noexcept
+        : _Mymtx(), _Myfile(), _Mymapping(), _Myview(nullptr), _Myview_size(0), _Myslots() {}
+
+    shred_journal::~shred_journal() noexcept {
+        _Unmap();
+    }
+
+    bool shred_journal::_Map(const uint64_t _Capacity) noexcept {
+        // Note: The new view is created before the current one is released, so that the journal
+        //       remains usable if it cannot be created.
+        const size_t _Size = static_cast<size_t>(sizeof(_Header) + _Capacity * sizeof(journal_entry));
+        unique_smart_ptr<_File_mapping> _Mapping;
+        try {
+            _Mapping = ::mjx::make_unique_smart_ptr<_File_mapping>(_Myfile);
+        } catch (...) {
+            return false;
+        }
+
+        if (!_Mapping->_Valid()) {
+            return false;
+        }
+
+        byte_t* const _View = _Mapping->_Map(0, _Size);
+        if (!_View) {
+            return false;
+        }
+
+        _Unmap();
+        _Mymapping   = ::std::move(_Mapping);
+        _Myview      = _View;
+        _Myview_size = _Size;
+        return true;
+    }
+
+    void shred_journal::_Unmap() noexcept {
+        if (_Myview) {
+            _File_mapping::_Unmap(_Myview, _Myview_size);
+            _Myview      = nullptr;
+            _Myview_size = 0;
+        }
+
+        _Mymapping = nullptr;
+    }
+
+    bool shred_journal::_Flush(const void* const _Data, const size_t _Size) noexcept {
+        return ::FlushViewOfFile(_Data, _Size) != 0 && ::FlushFileBuffers(_Myfile.native_handle()) != 0;
+    }
+
+    shred_journal::_Header& shred_journal::_Get_header() const noexcept {
+        return *reinterpret_cast<_Header*>(_Myview);
+    }
+
+    journal_entry* shred_journal::_Get_entries() const noexcept {
+        return reinterpret_cast<journal_entry*>(_Myview + sizeof(_Header));
+    }
+
+    bool shred_journal::_Grow() noexcept {
+        // Note: The file is extended before its header is updated. If the process dies in between,
+        //       the next run derives the capacity from the size of the file. Extending a mapped file
+        //       is allowed, so the current view stays valid until the new one replaces it.
+        const uint64_t _New_capacity = _Get_header().capacity * 2;
+        if (!_Myfile.resize(sizeof(_Header) + _New_capacity * sizeof(journal_entry))
+            || !_Map(_New_capacity)) { // keep the current entries
+            return false;
+        }
+
+        _Get_header().capacity = _New_capacity;
+        return _Flush(_Myview, sizeof(_Header));
+    }
+
+    bool shred_journal::open(const path& _Target) {
+        ::std::unique_lock<::std::shared_mutex> _Guard(_Mymtx);
+        if (!::mjx::exists(_Target)) {
+            if (!::mjx::create_file(_Target, &_Myfile)) {
+                return false;
+            }
+        } else if (!_Myfile.open(_Target, file_access::read | file_access::write)) {
+            return false;
+        }
+
+        const uint64_t _Size = _Myfile.size();
+        if (_Size == 0) { // new journal, format it
+            if (!_Myfile.resize(sizeof(_Header) + _Initial_capacity * sizeof(journal_entry))
+                || !_Map(_Initial_capacity)) {
+                _Myfile.close();
+                return false;
+            }
+
+            _Header& _Hdr = _Get_header();
+            ::memcpy(_Hdr.magic, _Magic, sizeof(_Magic));
+            _Hdr.version    = _Version;
+            _Hdr.entry_size = sizeof(journal_entry);
+            _Hdr.capacity   = _Initial_capacity;
+            _Hdr.count      = 0;
+            return _Flush(_Myview, sizeof(_Header));
+        }
+
+        const uint64_t _Capacity =
+            _Size >= sizeof(_Header) ? (_Size - sizeof(_Header)) / sizeof(journal_entry) : 0;
+        if (_Capacity == 0 || !_Map(_Capacity)) { // not a journal
+            _Myfile.close();
+            return false;
+        }
+
+        _Header& _Hdr = _Get_header();
+        if (::memcmp(_Hdr.magic, _Magic, sizeof(_Magic)) != 0 || _Hdr.version != _Version
+            || _Hdr.entry_size != sizeof(journal_entry) || _Hdr.count > _Capacity) { // damaged or foreign
+            _Unmap();
+            _Myfile.close();
+            return false;
+        }
+
+        _Hdr.capacity = _Capacity;
+        const journal_entry* const _Entries = _Get_entries();
+        for (size_t _Slot = 0; _Slot < _Hdr.count; ++_Slot) {
+            _Myslots.emplace(file_id{_Entries[_Slot].volume, _Entries[_Slot].index}, _Slot);
+        }
+
+        return true;
+    }
+
+    bool shred_journal::is_open() const noexcept {
+        return _Myview != nullptr;
+    }
+
+    bool shred_journal::identify(file_id& _Id) const noexcept {
+        return _Myview && ::mjx::query_file_id(_Myfile, _Id);
+    }
+
+    size_t shred_journal::attach(const file_id& _Id) {
+        // Note: A new entry is not flushed, losing it only means that the file starts from the beginning.
+        //       It becomes durable together with its first checkpoint.
+        ::std::unique_lock<::std::shared_mutex> _Guard(_Mymtx);
+        if (!_Myview) {
+            return npos;
+        }
+
+        const auto _Iter = _Myslots.find(_Id);
+        if (_Iter != _Myslots.end()) {
+            return _Iter->second;
+        }
+
+        if (_Get_header().count == _Get_header().capacity && !_Grow()) {
+            return npos;
+        }
+
+        _Header& _Hdr         = _Get_header();
+        const size_t _Slot    = static_cast<size_t>(_Hdr.count);
+        _Get_entries()[_Slot] = journal_entry{_Id.index, _Id.volume, journal_state::none, 0, 0, 0, 0, 0};
+        _Myslots.emplace(_Id, _Slot);
+        ++_Hdr.count;
+        return _Slot;
+    }
+
+    journal_entry shred_journal::bind(size_t& _Slot, const file_id& _Id) {
+        _Slot = _Id != file_id{0, 0} ? attach(_Id) : npos; // the progress must belong to a single file
+        return read(_Slot);
+    }
+
+    journal_entry shred_journal::read(const size_t _Slot) const noexcept {
+        ::std::shared_lock<::std::shared_mutex> _Guard(_Mymtx);
+        if (!_Myview || _Slot >= _Get_header().count) {
+            return journal_entry{0, 0, journal_state::none, 0, 0, 0, 0, 0};
+        }
+
+        return _Get_entries()[_Slot];
+    }
+
+    bool shred_journal::write(const size_t _Slot, const journal_entry& _Entry) noexcept {
+        // Note: An entry never straddles a sector, which the device writes atomically, so the entry
+        //       holds either the previous or the new checkpoint after a crash. The header is flushed
+        //       as well, since it holds the count of the entries.
+        ::std::shared_lock<::std::shared_mutex> _Guard(_Mymtx);
+        if (!_Myview || _Slot >= _Get_header().count) {
+            return false;
+        }
+
+        journal_entry& _Stored = _Get_entries()[_Slot];
+        _Stored                = _Entry;
+        return ::FlushViewOfFile(&_Stored, sizeof(journal_entry)) != 0
+            && ::FlushViewOfFile(_Myview, sizeof(_Header)) != 0
+            && ::FlushFileBuffers(_Myfile.native_handle()) != 0;
+    }
+
+    void shred_journal::finish(
+        const size_t _Slot, const shred_status _Status, const file_metadata& _Meta) noexcept {
+        if (!_Is_shredded(_Status)) { // keep the progress, a later run resumes the file
+            return;
+        }
+
+        journal_entry _Entry = read(_Slot);
+        _Entry.state         = journal_state::completed;
+        _Entry.size          = _Meta.size;
+        _Entry.last_write    = _Meta.last_write;
+        write(_Slot, _Entry);
+    }
+} // namespace mjx
\ No newline at end of file
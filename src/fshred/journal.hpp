@@ -0,0 +1,152 @@
+// journal.hpp
+
+// Copyright (c) Mateusz Jandura. All rights reserved.
+// SPDX-License-Identifier: Apache-2.0
+
+#pragma once
+#ifndef _FSHRED_JOURNAL_HPP_
+#define _FSHRED_JOURNAL_HPP_
+#include <cstddef>
+#include <cstdint>
+#include <fshred/identity.hpp>
+#include <fshred/mapping.hpp>
+#include <mjfs/file.hpp>
+#include <mjfs/path.hpp>
+#include <mjmem/smart_pointer.hpp>
+#include <shared_mutex>
+#include <unordered_map>
+
+namespace mjx {
+    enum class journal_state : uint8_t {
+        none, // the file has not been started yet
+        in_progress, // the file is being overwritten, the entry holds the last durable checkpoint
+        completed // the file has been overwritten and truncated
+    };
+
+    struct journal_entry { // progress of a single file, stored in the journal as is
+        uint64_t index; // file index on the volume
+        uint32_t volume; // volume serial number
+        journal_state state;
+        uint8_t method; // shred_method used by the checkpoint
+        uint8_t pass; // next pass to run
+        uint8_t fixed_value; // fixed value of the DoD 5220.22-M passes in progress
+        uint64_t size; // size of the file when it was started, or when it was completed
+        union {
+            uint64_t offset; // number of bytes of the pass that are durable, while in progress
+            uint64_t last_write; // last write time of the completed file, a FILETIME
+        };
+    };
+
+    static_assert(sizeof(journal_entry) == 32, "journal entries must not straddle a sector");
+
+    // checks whether the entry records the shredding of the file and the file has not been written since
+    bool is_completed(const journal_entry& _Entry, const file_metadata& _Meta) noexcept;
+
+    enum class shred_status : unsigned char; // defined in <fshred/job.hpp>
+
+    class shred_progress { // durable record of the progress of each file, shared by all workers
+    public:
+        virtual ~shred_progress() noexcept;
+
+        // binds the file to a slot, which may be chosen by the file, returns the progress recorded for it,
+        // an unidentified file (zero identifier) starts from the beginning
+        virtual journal_entry bind(size_t& _Slot, const file_id& _Id) = 0;
+
+        // returns the entry stored in the slot
+        virtual journal_entry read(const size_t _Slot) const noexcept = 0;
+
+        // stores the entry in the slot and makes it durable
+        virtual bool write(const size_t _Slot, const journal_entry& _Entry) noexcept = 0;
+
+        // records the result of the file and the metadata it was left with, later runs skip a shredded
+        // file until it is written again
+        virtual void finish(
+            const size_t _Slot, const shred_status _Status, const file_metadata& _Meta) noexcept = 0;
+
+    protected:
+        // checks whether the data of the file is gone, even if the file itself could not be deleted
+        static bool _Is_shredded(const shred_status _Status) noexcept;
+    };
+
+    class shred_journal : public shred_progress { // crash-safe record of the progress, mapped into memory
+    public:
+        shred_journal() noexcept;
+        ~shred_journal() noexcept override;
+
+        shred_journal(const shred_journal&)            = delete;
+        shred_journal& operator=(const shred_journal&) = delete;
+
+        static constexpr size_t npos = static_cast<size_t>(-1);
+
+        // opens the journal, creates it if it does not exist
+        bool open(const path& _Target);
+
+        // checks whether the journal is open
+        bool is_open() const noexcept;
+
+        // retrieves the identifier of the journal file, so that it is never shredded
+        bool identify(file_id& _Id) const noexcept;
+
+        // returns the slot of the file, adds a new entry if the file is not present
+        size_t attach(const file_id& _Id);
+
+        // binds the file to its own slot, an unidentified file gets no slot
+        journal_entry bind(size_t& _Slot, const file_id& _Id) override;
+
+        // returns the entry stored in the slot
+        journal_entry read(const size_t _Slot) const noexcept override;
+
+        // stores the entry in the slot and makes it durable
+        bool write(const size_t _Slot, const journal_entry& _Entry) noexcept override;
+
+        // marks a shredded file as completed, keeps the progress of the others
+        void finish(
+            const size_t _Slot, const shred_status _Status, const file_metadata& _Meta) noexcept override;
+
+    private:
+        struct _Header {
+            char magic[8];
+            uint32_t version;
+            uint32_t entry_size;
+            uint64_t capacity; // number of entries the journal has room for
+            uint64_t count; // number of used entries
+            byte_t reserved[32];
+        };
+
+        static_assert(sizeof(_Header) == 64, "the header must be a multiple of the entry size");
+
+        // maps the whole journal, the file must already have the size of the capacity,
+        // keeps the current view on failure
+        bool _Map(const uint64_t _Capacity) noexcept;
+
+        // releases the current view and mapping
+        void _Unmap() noexcept;
+
+        // doubles the capacity of the journal
+        bool _Grow() noexcept;
+
+        // writes the range of the view to the device
+        bool _Flush(const void* const _Data, const size_t _Size) noexcept;
+
+        // returns the header stored in the view
+        _Header& _Get_header() const noexcept;
+
+        // returns the entries stored in the view
+        journal_entry* _Get_entries() const noexcept;
+
+        static constexpr char _Magic[8]            = {'F', 'S', 'H', 'J', 'R', 'N', 'L', '\0'};
+        static constexpr uint32_t _Version         = 1;
+        static constexpr uint64_t _Initial_capacity = 4096;
+
+        // Note: Workers write their entries concurrently while holding the lock in shared mode.
+        //       Growing the journal moves the view, so it holds the lock in exclusive mode.
+        mutable ::std::shared_mutex _Mymtx;
+        file _Myfile;
+        unique_smart_ptr<_File_mapping> _Mymapping;
+        byte_t* _Myview;
+        size_t _Myview_size;
+        ::std::unordered_map<file_id, size_t, _File_id_hash> _Myslots;
+    };
+} // namespace mjx
+
+#endif // _FSHRED_JOURNAL_HPP_
\ No newline at end of file
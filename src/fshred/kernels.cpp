@@ -0,0 +1,438 @@
+// kernels.cpp
+
+// Copyright (c) Mateusz Jandura. All rights reserved.
+// SPDX-License-Identifier: Apache-2.0
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <fshred/kernels.hpp>
+#include <fshred/tinywin.hpp>
+#include <intrin.h>
+
+namespace mjx {
+    inline bool _Has_os_support(const unsigned long long _Mask) noexcept {
+        // the OS must save the extended registers on context switches
+        int _Regs[4];
+        ::__cpuid(_Regs, 1);
+        if ((_Regs[2] & (1 << 27)) == 0) { // OSXSAVE not set, XGETBV is not available
+            return false;
+        }
+
+        return (::_xgetbv(0) & _Mask) == _Mask;
+    }
+
+    inline simd_level _Detect_simd_level() noexcept {
+        int _Regs[4];
+        ::__cpuid(_Regs, 0);
+        const int _Max_leaf = _Regs[0];
+        if (_Max_leaf >= 7) {
+            ::__cpuidex(_Regs, 7, 0);
+            const bool _Avx512f  = (_Regs[1] & (1 << 16)) != 0;
+            const bool _Avx512bw = (_Regs[1] & (1 << 30)) != 0;
+            const bool _Avx2     = (_Regs[1] & (1 << 5)) != 0;
+            if (_Avx512f && _Avx512bw && _Has_os_support(0xE6)) { // XMM, YMM and ZMM state
+                return simd_level::avx512;
+            }
+
+            if (_Avx2 && _Has_os_support(0x06)) { // XMM and YMM state
+                return simd_level::avx2;
+            }
+        }
+
+        ::__cpuid(_Regs, 1);
+        return (_Regs[3] & (1 << 26)) != 0 ? simd_level::sse2 : simd_level::none;
+    }
+
+    struct _Sse2_traits {
+        using _Vec                    = __m128i;
+        static constexpr size_t _Size = sizeof(_Vec);
+
+        static _Vec _Broadcast(const byte_t _Val) noexcept {
+            return ::_mm_set1_epi8(static_cast<char>(_Val));
+        }
+
+        static _Vec _Load(const byte_t* const _Src) noexcept {
+            return ::_mm_loadu_si128(reinterpret_cast<const _Vec*>(_Src));
+        }
+
+        static void _Stream(byte_t* const _Dest, const _Vec _Val) noexcept {
+            ::_mm_stream_si128(reinterpret_cast<_Vec*>(_Dest), _Val);
+        }
+
+        static bool _Equal(const _Vec _Left, const _Vec _Right) noexcept {
+            return ::_mm_movemask_epi8(::_mm_cmpeq_epi8(_Left, _Right)) == 0xFFFF;
+        }
+
+        static _Vec _Broadcast_word(const uint32_t _Val) noexcept {
+            return ::_mm_set1_epi32(static_cast<int>(_Val));
+        }
+
+        static void _Store(byte_t* const _Dest, const _Vec _Val) noexcept {
+            ::_mm_storeu_si128(reinterpret_cast<_Vec*>(_Dest), _Val);
+        }
+
+        static _Vec _Add_words(const _Vec _Left, const _Vec _Right) noexcept {
+            return ::_mm_add_epi32(_Left, _Right);
+        }
+
+        static _Vec _Xor(const _Vec _Left, const _Vec _Right) noexcept {
+            return ::_mm_xor_si128(_Left, _Right);
+        }
+
+        template <int _Shift>
+        static _Vec _Rotate_words(const _Vec _Val) noexcept {
+            return ::_mm_or_si128(::_mm_slli_epi32(_Val, _Shift), ::_mm_srli_epi32(_Val, 32 - _Shift));
+        }
+    };
+
+    struct _Avx2_traits {
+        using _Vec                    = __m256i;
+        static constexpr size_t _Size = sizeof(_Vec);
+
+        static _Vec _Broadcast(const byte_t _Val) noexcept {
+            return ::_mm256_set1_epi8(static_cast<char>(_Val));
+        }
+
+        static _Vec _Load(const byte_t* const _Src) noexcept {
+            return ::_mm256_loadu_si256(reinterpret_cast<const _Vec*>(_Src));
+        }
+
+        static void _Stream(byte_t* const _Dest, const _Vec _Val) noexcept {
+            ::_mm256_stream_si256(reinterpret_cast<_Vec*>(_Dest), _Val);
+        }
+
+        static bool _Equal(const _Vec _Left, const _Vec _Right) noexcept {
+            return ::_mm256_movemask_epi8(::_mm256_cmpeq_epi8(_Left, _Right)) == -1;
+        }
+
+        static _Vec _Broadcast_word(const uint32_t _Val) noexcept {
+            return ::_mm256_set1_epi32(static_cast<int>(_Val));
+        }
+
+        static void _Store(byte_t* const _Dest, const _Vec _Val) noexcept {
+            ::_mm256_storeu_si256(reinterpret_cast<_Vec*>(_Dest), _Val);
+        }
+
+        static _Vec _Add_words(const _Vec _Left, const _Vec _Right) noexcept {
+            return ::_mm256_add_epi32(_Left, _Right);
+        }
+
+        static _Vec _Xor(const _Vec _Left, const _Vec _Right) noexcept {
+            return ::_mm256_xor_si256(_Left, _Right);
+        }
+
+        template <int _Shift>
+        static _Vec _Rotate_words(const _Vec _Val) noexcept {
+            return ::_mm256_or_si256(
+                ::_mm256_slli_epi32(_Val, _Shift), ::_mm256_srli_epi32(_Val, 32 - _Shift));
+        }
+    };
+
+    struct _Avx512_traits {
+        using _Vec                    = __m512i;
+        static constexpr size_t _Size = sizeof(_Vec);
+
+        static _Vec _Broadcast(const byte_t _Val) noexcept {
+            return ::_mm512_set1_epi8(static_cast<char>(_Val));
+        }
+
+        static _Vec _Load(const byte_t* const _Src) noexcept {
+            return ::_mm512_loadu_si512(_Src);
+        }
+
+        static void _Stream(byte_t* const _Dest, const _Vec _Val) noexcept {
+            ::_mm512_stream_si512(reinterpret_cast<_Vec*>(_Dest), _Val);
+        }
+
+        static bool _Equal(const _Vec _Left, const _Vec _Right) noexcept {
+            return ::_mm512_cmpneq_epi8_mask(_Left, _Right) == 0;
+        }
+
+        static _Vec _Broadcast_word(const uint32_t _Val) noexcept {
+            return ::_mm512_set1_epi32(static_cast<int>(_Val));
+        }
+
+        static void _Store(byte_t* const _Dest, const _Vec _Val) noexcept {
+            ::_mm512_storeu_si512(_Dest, _Val);
+        }
+
+        static _Vec _Add_words(const _Vec _Left, const _Vec _Right) noexcept {
+            return ::_mm512_add_epi32(_Left, _Right);
+        }
+
+        static _Vec _Xor(const _Vec _Left, const _Vec _Right) noexcept {
+            return ::_mm512_xor_si512(_Left, _Right);
+        }
+
+        template <int _Shift>
+        static _Vec _Rotate_words(const _Vec _Val) noexcept {
+            return ::_mm512_rol_epi32(_Val, _Shift);
+        }
+    };
+
+    inline size_t _Misalignment(const byte_t* const _Ptr, const size_t _Align) noexcept {
+        // returns the number of bytes before the next aligned address
+        return (_Align - (reinterpret_cast<uintptr_t>(_Ptr) & (_Align - 1))) & (_Align - 1);
+    }
+
+    template <class _Traits>
+    inline void _Fill_non_temporal(byte_t* _Buf, size_t _Size, const byte_t _Val) noexcept {
+        // non-temporal stores require aligned addresses, the unaligned ends are filled as usual
+        const size_t _Head = (::std::min)(_Misalignment(_Buf, _Traits::_Size), _Size);
+        ::memset(_Buf, _Val, _Head);
+        _Buf  += _Head;
+        _Size -= _Head;
+
+        const typename _Traits::_Vec _Vec = _Traits::_Broadcast(_Val);
+        for (; _Size >= _Traits::_Size; _Buf += _Traits::_Size, _Size -= _Traits::_Size) {
+            _Traits::_Stream(_Buf, _Vec);
+        }
+
+        ::memset(_Buf, _Val, _Size);
+        ::_mm_sfence(); // make the stores visible before the buffer is written
+    }
+
+    template <class _Traits>
+    inline void _Copy_non_temporal(byte_t* _Dest, const byte_t* _Src, size_t _Size) noexcept {
+        const size_t _Head = (::std::min)(_Misalignment(_Dest, _Traits::_Size), _Size);
+        ::memcpy(_Dest, _Src, _Head);
+        _Dest += _Head;
+        _Src  += _Head;
+        _Size -= _Head;
+        for (; _Size >= _Traits::_Size; _Size -= _Traits::_Size) {
+            _Traits::_Stream(_Dest, _Traits::_Load(_Src));
+            _Dest += _Traits::_Size;
+            _Src  += _Traits::_Size;
+        }
+
+        ::memcpy(_Dest, _Src, _Size);
+        ::_mm_sfence(); // make the stores visible before the buffer is written
+    }
+
+    template <class _Traits>
+    inline bool _Equal_buffers(const byte_t* _Left, const byte_t* _Right, size_t _Size) noexcept {
+        for (; _Size >= _Traits::_Size; _Size -= _Traits::_Size) {
+            if (!_Traits::_Equal(_Traits::_Load(_Left), _Traits::_Load(_Right))) {
+                return false;
+            }
+
+            _Left  += _Traits::_Size;
+            _Right += _Traits::_Size;
+        }
+
+        return ::memcmp(_Left, _Right, _Size) == 0;
+    }
+
+    // Note: The first four words of every ChaCha20 block spell "expand 32-byte k". They are followed
+    //       by the key, the 64-bit block counter and the 64-bit nonce, as in the original layout.
+    inline constexpr uint32_t _Chacha20_constants[4] = {0x6170'7865, 0x3320'646E, 0x7962'2D32, 0x6B20'6574};
+
+    template <class _Traits>
+    inline void _Chacha20_quarter_round(typename _Traits::_Vec& _Ax, typename _Traits::_Vec& _Bx,
+        typename _Traits::_Vec& _Cx, typename _Traits::_Vec& _Dx) noexcept {
+        _Ax = _Traits::_Add_words(_Ax, _Bx);
+        _Dx = _Traits::template _Rotate_words<16>(_Traits::_Xor(_Dx, _Ax));
+        _Cx = _Traits::_Add_words(_Cx, _Dx);
+        _Bx = _Traits::template _Rotate_words<12>(_Traits::_Xor(_Bx, _Cx));
+        _Ax = _Traits::_Add_words(_Ax, _Bx);
+        _Dx = _Traits::template _Rotate_words<8>(_Traits::_Xor(_Dx, _Ax));
+        _Cx = _Traits::_Add_words(_Cx, _Dx);
+        _Bx = _Traits::template _Rotate_words<7>(_Traits::_Xor(_Bx, _Cx));
+    }
+
+    template <class _Traits>
+    inline void _Chacha20_blocks(const uint32_t* const _Key, const uint64_t _Nonce, uint64_t _Counter,
+        byte_t* _Buf, size_t _Count) noexcept {
+        // Note: Each lane of a vector holds the same word of a different block, so a single pass
+        //       of the rounds generates as many consecutive blocks as there are lanes. The blocks are
+        //       then gathered from the lanes. A partial batch discards the blocks it does not need.
+        using _Vec                     = typename _Traits::_Vec;
+        static constexpr size_t _Lanes = _Traits::_Size / sizeof(uint32_t);
+        uint32_t _Low[_Lanes];
+        uint32_t _High[_Lanes];
+        uint32_t _Words[16][_Lanes];
+        _Vec _State[16];
+        _Vec _Mixed[16];
+        size_t _Batch;
+        for (size_t _Idx = 0; _Idx < 4; ++_Idx) {
+            _State[_Idx] = _Traits::_Broadcast_word(_Chacha20_constants[_Idx]);
+        }
+
+        for (size_t _Idx = 0; _Idx < 8; ++_Idx) {
+            _State[4 + _Idx] = _Traits::_Broadcast_word(_Key[_Idx]);
+        }
+
+        _State[14] = _Traits::_Broadcast_word(static_cast<uint32_t>(_Nonce));
+        _State[15] = _Traits::_Broadcast_word(static_cast<uint32_t>(_Nonce >> 32));
+        for (; _Count > 0; _Count -= _Batch, _Counter += _Batch, _Buf += _Batch * chacha20_block_size) {
+            for (size_t _Lane = 0; _Lane < _Lanes; ++_Lane) { // the counter may carry into the high word
+                _Low[_Lane]  = static_cast<uint32_t>(_Counter + _Lane);
+                _High[_Lane] = static_cast<uint32_t>((_Counter + _Lane) >> 32);
+            }
+
+            _State[12] = _Traits::_Load(reinterpret_cast<const byte_t*>(_Low));
+            _State[13] = _Traits::_Load(reinterpret_cast<const byte_t*>(_High));
+            for (size_t _Idx = 0; _Idx < 16; ++_Idx) {
+                _Mixed[_Idx] = _State[_Idx];
+            }
+
+            for (int _Round = 0; _Round < 10; ++_Round) { // 20 rounds, two per iteration
+                _Chacha20_quarter_round<_Traits>(_Mixed[0], _Mixed[4], _Mixed[8], _Mixed[12]);
+                _Chacha20_quarter_round<_Traits>(_Mixed[1], _Mixed[5], _Mixed[9], _Mixed[13]);
+                _Chacha20_quarter_round<_Traits>(_Mixed[2], _Mixed[6], _Mixed[10], _Mixed[14]);
+                _Chacha20_quarter_round<_Traits>(_Mixed[3], _Mixed[7], _Mixed[11], _Mixed[15]);
+                _Chacha20_quarter_round<_Traits>(_Mixed[0], _Mixed[5], _Mixed[10], _Mixed[15]);
+                _Chacha20_quarter_round<_Traits>(_Mixed[1], _Mixed[6], _Mixed[11], _Mixed[12]);
+                _Chacha20_quarter_round<_Traits>(_Mixed[2], _Mixed[7], _Mixed[8], _Mixed[13]);
+                _Chacha20_quarter_round<_Traits>(_Mixed[3], _Mixed[4], _Mixed[9], _Mixed[14]);
+            }
+
+            for (size_t _Idx = 0; _Idx < 16; ++_Idx) {
+                _Traits::_Store(reinterpret_cast<byte_t*>(_Words[_Idx]),
+                    _Traits::_Add_words(_Mixed[_Idx], _State[_Idx]));
+            }
+
+            _Batch = (::std::min)(_Lanes, _Count);
+            for (size_t _Block = 0; _Block < _Batch; ++_Block) { // little-endian, as the keystream bytes
+                for (size_t _Idx = 0; _Idx < 16; ++_Idx) {
+                    ::memcpy(_Buf + _Block * chacha20_block_size + _Idx * sizeof(uint32_t),
+                        &_Words[_Idx][_Block], sizeof(uint32_t));
+                }
+            }
+        }
+
+        ::SecureZeroMemory(_Words, sizeof(_Words)); // the discarded blocks have not been written yet
+    }
+
+    inline uint32_t _Rotate_left(const uint32_t _Val, const int _Shift) noexcept {
+        return (_Val << _Shift) | (_Val >> (32 - _Shift));
+    }
+
+    inline void _Quarter_round(uint32_t& _Ax, uint32_t& _Bx, uint32_t& _Cx, uint32_t& _Dx) noexcept {
+        _Ax += _Bx;
+        _Dx = _Rotate_left(_Dx ^ _Ax, 16);
+        _Cx += _Dx;
+        _Bx = _Rotate_left(_Bx ^ _Cx, 12);
+        _Ax += _Bx;
+        _Dx = _Rotate_left(_Dx ^ _Ax, 8);
+        _Cx += _Dx;
+        _Bx = _Rotate_left(_Bx ^ _Cx, 7);
+    }
+
+    inline void _Chacha20_blocks_portable(const uint32_t* const _Key, const uint64_t _Nonce,
+        uint64_t _Counter, byte_t* _Buf, size_t _Count) noexcept {
+        uint32_t _Block[16];
+        for (; _Count > 0; --_Count, ++_Counter, _Buf += chacha20_block_size) {
+            const uint32_t _State[16] = {_Chacha20_constants[0], _Chacha20_constants[1],
+                _Chacha20_constants[2], _Chacha20_constants[3], _Key[0], _Key[1], _Key[2], _Key[3],
+                _Key[4], _Key[5], _Key[6], _Key[7], static_cast<uint32_t>(_Counter),
+                static_cast<uint32_t>(_Counter >> 32), static_cast<uint32_t>(_Nonce),
+                static_cast<uint32_t>(_Nonce >> 32)};
+            ::memcpy(_Block, _State, sizeof(_State));
+            for (int _Round = 0; _Round < 10; ++_Round) { // 20 rounds, two per iteration
+                _Quarter_round(_Block[0], _Block[4], _Block[8], _Block[12]);
+                _Quarter_round(_Block[1], _Block[5], _Block[9], _Block[13]);
+                _Quarter_round(_Block[2], _Block[6], _Block[10], _Block[14]);
+                _Quarter_round(_Block[3], _Block[7], _Block[11], _Block[15]);
+                _Quarter_round(_Block[0], _Block[5], _Block[10], _Block[15]);
+                _Quarter_round(_Block[1], _Block[6], _Block[11], _Block[12]);
+                _Quarter_round(_Block[2], _Block[7], _Block[8], _Block[13]);
+                _Quarter_round(_Block[3], _Block[4], _Block[9], _Block[14]);
+            }
+
+            for (size_t _Idx = 0; _Idx < 16; ++_Idx) { // little-endian, as the keystream bytes
+                _Block[_Idx] += _State[_Idx];
+            }
+
+            ::memcpy(_Buf, _Block, chacha20_block_size);
+        }
+
+        ::SecureZeroMemory(_Block, sizeof(_Block));
+    }
+
+    inline void _Fill_portable(byte_t* const _Buf, const size_t _Size, const byte_t _Val) noexcept {
+        ::memset(_Buf, _Val, _Size);
+    }
+
+    inline void _Copy_portable(byte_t* const _Dest, const byte_t* const _Src, const size_t _Size) noexcept {
+        ::memcpy(_Dest, _Src, _Size);
+    }
+
+    inline bool _Equal_portable(
+        const byte_t* const _Left, const byte_t* const _Right, const size_t _Size) noexcept {
+        return ::memcmp(_Left, _Right, _Size) == 0;
+    }
+
+    struct _Kernel_table {
+        simd_level _Level;
+        void (*_Fill)(byte_t*, size_t, byte_t) noexcept;
+        void (*_Copy)(byte_t*, const byte_t*, size_t) noexcept;
+        bool (*_Equal)(const byte_t*, const byte_t*, size_t) noexcept;
+        void (*_Chacha20)(const uint32_t*, uint64_t, uint64_t, byte_t*, size_t) noexcept;
+    };
+
+    // Note: The table is written once by bind_kernels() before any worker starts and only read
+    //       afterwards, so it needs no synchronization. Until then, the portable kernels are used.
+    _Kernel_table _Kernels = {
+        simd_level::none, &_Fill_portable, &_Copy_portable, &_Equal_portable, &_Chacha20_blocks_portable};
+
+    template <class _Traits>
+    inline void _Bind_kernels_for(const simd_level _Level) noexcept {
+        _Kernels._Level    = _Level;
+        _Kernels._Fill     = &_Fill_non_temporal<_Traits>;
+        _Kernels._Copy     = &_Copy_non_temporal<_Traits>;
+        _Kernels._Equal    = &_Equal_buffers<_Traits>;
+        _Kernels._Chacha20 = &_Chacha20_blocks<_Traits>;
+    }
+
+    void bind_kernels() noexcept {
+        switch (_Detect_simd_level()) {
+        case simd_level::avx512:
+            _Bind_kernels_for<_Avx512_traits>(simd_level::avx512);
+            break;
+        case simd_level::avx2:
+            _Bind_kernels_for<_Avx2_traits>(simd_level::avx2);
+            break;
+        case simd_level::sse2:
+            _Bind_kernels_for<_Sse2_traits>(simd_level::sse2);
+            break;
+        default:
+            break;
+        }
+    }
+
+    simd_level bound_simd_level() noexcept {
+        return _Kernels._Level;
+    }
+
+    const char* simd_level_name(const simd_level _Level) noexcept {
+        switch (_Level) {
+        case simd_level::sse2:
+            return "SSE2";
+        case simd_level::avx2:
+            return "AVX2";
+        case simd_level::avx512:
+            return "AVX-512";
+        default:
+            return "none";
+        }
+    }
+
+    void fill_non_temporal(byte_t* const _Buf, const size_t _Size, const byte_t _Val) noexcept {
+        _Kernels._Fill(_Buf, _Size, _Val);
+    }
+
+    void copy_non_temporal(byte_t* const _Dest, const byte_t* const _Src, const size_t _Size) noexcept {
+        _Kernels._Copy(_Dest, _Src, _Size);
+    }
+
+    bool equal_buffers(const byte_t* const _Left, const byte_t* const _Right, const size_t _Size) noexcept {
+        return _Kernels._Equal(_Left, _Right, _Size);
+    }
+
+    void generate_chacha20_blocks(const uint32_t (&_Key)[8], const uint64_t _Nonce, const uint64_t _Counter,
+        byte_t* const _Buf, const size_t _Count) noexcept {
+        _Kernels._Chacha20(_Key, _Nonce, _Counter, _Buf, _Count);
+    }
+} // namespace mjx
\ No newline at end of file
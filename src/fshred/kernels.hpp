@@ -0,0 +1,46 @@
+// kernels.hpp
+
+// Copyright (c) Mateusz Jandura. All rights reserved.
+// SPDX-License-Identifier: Apache-2.0
+
+#pragma once
+#ifndef _FSHRED_KERNELS_HPP_
+#define _FSHRED_KERNELS_HPP_
+#include <cstddef>
+#include <cstdint>
+#include <mjstr/char_traits.hpp>
+
+namespace mjx {
+    enum class simd_level : unsigned char {
+        none, // portable code only
+        sse2,
+        avx2,
+        avx512 // AVX-512 F and BW
+    };
+
+    // detects the CPU features and binds the kernels, must be called once before starting any thread
+    void bind_kernels() noexcept;
+
+    // returns the SIMD level the kernels have been bound to
+    simd_level bound_simd_level() noexcept;
+
+    // returns the name of the SIMD level, used in reports
+    const char* simd_level_name(const simd_level _Level) noexcept;
+
+    // fills the buffer with the value, bypasses the CPU caches if supported
+    void fill_non_temporal(byte_t* const _Buf, const size_t _Size, const byte_t _Val) noexcept;
+
+    // copies the buffer, bypasses the CPU caches on the destination side if supported
+    void copy_non_temporal(byte_t* const _Dest, const byte_t* const _Src, const size_t _Size) noexcept;
+
+    // checks whether both buffers contain the same bytes
+    bool equal_buffers(const byte_t* const _Left, const byte_t* const _Right, const size_t _Size) noexcept;
+
+    inline constexpr size_t chacha20_block_size = 64;
+
+    // generates the specified number of consecutive ChaCha20 blocks, starting with the counter
+    void generate_chacha20_blocks(const uint32_t (&_Key)[8], const uint64_t _Nonce, const uint64_t _Counter,
+        byte_t* const _Buf, const size_t _Count) noexcept;
+} // namespace mjx
+
+#endif // _FSHRED_KERNELS_HPP_
\ No newline at end of file
@@ -4,20 +4,27 @@
 // SPDX-License-Identifier: Apache-2.0
 
 #include <cstdio>
+#include <fshred/batch.hpp>
 #include <fshred/dialog.hpp>
+#include <fshred/kernels.hpp>
 #include <fshred/program.hpp>
-#include <fshred/shredder.hpp>
 #include <fshred/tinywin.hpp>
-#include <mjfs/status.hpp>
 
 namespace mjx {
-    enum class _App_error : int {
-        _Success,
-        _Target_not_specified,
-        _Bad_file,
-        _Cannot_shred_file,
-        _Cannot_delete_file,
-        _Unknown_error
+    enum class _App_error : int { // the values are the exit codes, never renumber them
+        _Success                 = 0,
+        _Target_not_specified    = 1,
+        _Bad_file                = 2,
+        _Cannot_shred_file       = 3,
+        _Cannot_delete_file      = 4,
+        _Unknown_error           = 5,
+        _Cannot_write_report     = 6,
+        _Verification_failed     = 7,
+        _Cannot_open_journal     = 8,
+        _Cancelled               = 9,
+        _Cannot_open_manifest    = 10,
+        _Invalid_option          = 11,
+        _Cannot_allocate_buffers = 12
     };
 
     inline const wchar_t* _Translate_app_error(const _App_error _Error) noexcept {
@@ -30,11 +37,52 @@ namespace mjx {
             return L"Failed to shred the file";
         case _App_error::_Cannot_delete_file:
             return L"Failed to delete the file";
+        case _App_error::_Cannot_write_report:
+            return L"Failed to write the report";
+        case _App_error::_Verification_failed:
+            return L"Failed to verify the shredded file";
+        case _App_error::_Cannot_open_journal:
+            return L"Could not open the journal";
+        case _App_error::_Cancelled:
+            return L"The shredding has been cancelled";
+        case _App_error::_Cannot_open_manifest:
+            return L"Could not open the manifest";
+        case _App_error::_Invalid_option:
+            return L"Missing or invalid value of an option";
+        case _App_error::_Cannot_allocate_buffers:
+            return L"Could not allocate the write buffers";
         default:
             return L"(Unknown error)";
         }
     }
 
+    inline _App_error _Translate_shred_status(const shred_status _Status) noexcept {
+        switch (_Status) {
+        case shred_status::success:
+            return _App_error::_Success;
+        case shred_status::bad_file:
+            return _App_error::_Bad_file;
+        case shred_status::cannot_shred_file:
+            return _App_error::_Cannot_shred_file;
+        case shred_status::cannot_delete_file:
+            return _App_error::_Cannot_delete_file;
+        case shred_status::cannot_write_report:
+            return _App_error::_Cannot_write_report;
+        case shred_status::verification_failed:
+            return _App_error::_Verification_failed;
+        case shred_status::cannot_open_journal:
+            return _App_error::_Cannot_open_journal;
+        case shred_status::cancelled:
+            return _App_error::_Cancelled;
+        case shred_status::cannot_open_manifest:
+            return _App_error::_Cannot_open_manifest;
+        case shred_status::cannot_allocate_buffers:
+            return _App_error::_Cannot_allocate_buffers;
+        default:
+            return _App_error::_Unknown_error;
+        }
+    }
+
     inline void _Report_error(const _App_error _Error) noexcept {
         wchar_t _Msg[128] = {0}; // should fit longest possible message
         ::swprintf_s(_Msg,
@@ -45,8 +93,12 @@ namespace mjx {
 
     inline _App_error _Unsafe_entry_point(program_args& _Args) {
         program_options _Options;
-        program_args::parse(_Args, _Options);
-        if (_Options.path_to_file.empty()) {
+        if (!program_args::parse(_Args, _Options)) { // never shred with settings other than requested
+            return _App_error::_Invalid_option;
+        }
+
+        if (_Options.targets.empty() && _Options.list_path.empty()
+            && _Options.manifest_path.empty()) {
             return _App_error::_Target_not_specified;
         }
 
@@ -67,41 +119,12 @@ namespace mjx {
             }
         }
 
-        {
-            file_access _Access;
-            file_flag _Flags;
-            if (_Options.delete_after_shredding) { // request all access
-                _Access = file_access::all;
-                _Flags  = file_flag::delete_on_close;
-            } else { // request write-only access
-                _Access = file_access::write;
-                _Flags  = file_flag::none;
-            }
-
-            file _File(_Options.path_to_file, _Access, file_share::none, _Flags);
-            if (!_File.is_open() && _Options.delete_after_shredding) { // try to open with write-only access
-                if (!_File.open(_Options.path_to_file, file_access::write, file_share::none, _Flags)) {
-                    // could not grant the minimum required access, break
-                    return _App_error::_Bad_file;
-                }
-            }
-
-            if (!securely_shred_file(_File)) {
-                return _App_error::_Cannot_shred_file;
-            }
-        } // closes and possibly deletes the file
-
-        // Note: At this step, the file should be closed and, if the caller specified a special flag,
-        //       deleted. Deletion of the file should be handled automatically based on the provided
-        //       flags, so it is valid to check whether the file still exists at this point.
-        if (_Options.delete_after_shredding && ::mjx::exists(_Options.path_to_file)) {
-            return _App_error::_Cannot_delete_file;
-        }
-
-        return _App_error::_Success;
+        shred_batch _Batch(_Options);
+        return _Translate_shred_status(_Batch.run());
     }
 
     inline _App_error _Entry_point(program_args& _Args) noexcept {
+        ::mjx::bind_kernels(); // select the best kernels for this CPU before any worker starts
         _App_error _Error;
         try {
             _Error = _Unsafe_entry_point(_Args);
@@ -109,7 +132,9 @@ namespace mjx {
             _Error = _App_error::_Unknown_error;
         }
 
-        if (_Error != _App_error::_Success) { // report an error
+        // Note: A cancellation is requested by another process, which learns about it from the exit code.
+        //       A message box would block the process until someone closes it.
+        if (_Error != _App_error::_Success && _Error != _App_error::_Cancelled) { // report an error
             _Report_error(_Error);
         }
 
@@ -0,0 +1,208 @@
+// manifest.cpp
+
+// Copyright (c) Mateusz Jandura. All rights reserved.
+// SPDX-License-Identifier: Apache-2.0
+
+#include <cstring>
+#include <fshred/job.hpp>
+#include <fshred/manifest.hpp>
+#include <fshred/tinywin.hpp>
+#include <limits>
+
+namespace mjx {
+    shred_manifest::shred_manifest() noexcept
+        : _Myfile(), _Mymapping(), _Myview(nullptr), _Myview_size(0) {}
+
+    shred_manifest::~shred_manifest() noexcept {
+        _Close();
+    }
+
+    void shred_manifest::_Close() noexcept {
+        if (_Myview) {
+            _File_mapping::_Unmap(_Myview, _Myview_size);
+            _Myview      = nullptr;
+            _Myview_size = 0;
+        }
+
+        _Mymapping = nullptr;
+        _Myfile.close();
+    }
+
+    bool shred_manifest::_Validate() const noexcept {
+        // Note: The manifest comes from another tool, so every range is checked before it is used.
+        //       The checks are written so that they cannot overflow.
+        const uint64_t _Size = static_cast<uint64_t>(_Myview_size);
+        if (_Size < sizeof(manifest_header)) {
+            return false;
+        }
+
+        const manifest_header& _Hdr = _Get_header();
+        if (::memcmp(_Hdr.magic, _Magic, sizeof(_Magic)) != 0 || _Hdr.version != _Version
+            || _Hdr.record_size != sizeof(manifest_record)) { // foreign or newer format
+            return false;
+        }
+
+        if (_Hdr.records_offset < sizeof(manifest_header)
+            || _Hdr.records_offset % sizeof(manifest_record) != 0 || _Hdr.records_offset > _Size
+            || _Hdr.record_count > (_Size - _Hdr.records_offset) / sizeof(manifest_record)) {
+            return false;
+        }
+
+        return _Hdr.strings_offset % 2 == 0 && _Hdr.strings_offset <= _Size
+            && _Hdr.strings_size <= _Size - _Hdr.strings_offset;
+    }
+
+    bool shred_manifest::open(const path& _Target) {
+        _Close();
+        if (!_Myfile.open(_Target, file_access::read | file_access::write)) {
+            return false;
+        }
+
+        const uint64_t _Size = _Myfile.size();
+        if (_Size < sizeof(manifest_header)
+            || _Size > (::std::numeric_limits<size_t>::max)()) { // empty or does not fit in the address space
+            _Close();
+            return false;
+        }
+
+        try {
+            _Mymapping = ::mjx::make_unique_smart_ptr<_File_mapping>(_Myfile);
+        } catch (...) {
+            _Close();
+            return false;
+        }
+
+        if (!_Mymapping->_Valid()) {
+            _Close();
+            return false;
+        }
+
+        _Myview_size = static_cast<size_t>(_Size);
+        _Myview      = _Mymapping->_Map(0, _Myview_size);
+        if (!_Myview || !_Validate()) {
+            _Close();
+            return false;
+        }
+
+        return true;
+    }
+
+    bool shred_manifest::is_open() const noexcept {
+        return _Myview != nullptr;
+    }
+
+    bool shred_manifest::identify(file_id& _Id) const noexcept {
+        return _Myview && ::mjx::query_file_id(_Myfile, _Id);
+    }
+
+    size_t shred_manifest::size() const noexcept {
+        return _Myview ? static_cast<size_t>(_Get_header().record_count) : 0;
+    }
+
+    const manifest_header& shred_manifest::_Get_header() const noexcept {
+        return *reinterpret_cast<const manifest_header*>(_Myview);
+    }
+
+    manifest_record* shred_manifest::_Get_records() const noexcept {
+        return reinterpret_cast<manifest_record*>(_Myview + _Get_header().records_offset);
+    }
+
+    const manifest_record& shred_manifest::record(const size_t _Slot) const noexcept {
+        return _Get_records()[_Slot];
+    }
+
+    unicode_string_view shred_manifest::target(const size_t _Slot) const noexcept {
+        const manifest_header& _Hdr = _Get_header();
+        const manifest_record& _Rec = _Get_records()[_Slot];
+        const uint64_t _Bytes       = static_cast<uint64_t>(_Rec.path_length) * sizeof(wchar_t);
+        if (_Rec.path_offset % 2 != 0 || _Rec.path_offset > _Hdr.strings_size
+            || _Bytes > _Hdr.strings_size - _Rec.path_offset) { // points outside the string table
+            return unicode_string_view{};
+        }
+
+        return unicode_string_view{reinterpret_cast<const wchar_t*>(
+            _Myview + _Hdr.strings_offset + _Rec.path_offset), static_cast<size_t>(_Rec.path_length)};
+    }
+
+    bool shred_manifest::_Flush(const void* const _Data, const size_t _Size) noexcept {
+        return ::FlushViewOfFile(_Data, _Size) != 0 && ::FlushFileBuffers(_Myfile.native_handle()) != 0;
+    }
+
+    journal_entry shred_manifest::attach(const size_t _Slot, const file_id& _Id) noexcept {
+        // Note: The progress belongs to the file it was recorded for. If the path now refers to another
+        //       file, the file starts from the beginning. The binding is not flushed, losing it only
+        //       means the same. It becomes durable together with the first checkpoint.
+        journal_entry& _Entry = _Get_records()[_Slot].progress;
+        if (_Entry.index != _Id.index || _Entry.volume != _Id.volume || _Id == file_id{0, 0}) {
+            _Entry = journal_entry{_Id.index, _Id.volume, journal_state::none, 0, 0, 0, 0, 0};
+        }
+
+        return _Entry;
+    }
+
+    journal_entry shred_manifest::bind(size_t& _Slot, const file_id& _Id) {
+        return attach(_Slot, _Id);
+    }
+
+    journal_entry shred_manifest::read(const size_t _Slot) const noexcept {
+        if (!_Myview || _Slot >= size()) {
+            return journal_entry{0, 0, journal_state::none, 0, 0, 0, 0, 0};
+        }
+
+        return _Get_records()[_Slot].progress;
+    }
+
+    bool shred_manifest::write(const size_t _Slot, const journal_entry& _Entry) noexcept {
+        if (!_Myview || _Slot >= size()) {
+            return false;
+        }
+
+        manifest_record& _Rec = _Get_records()[_Slot];
+        _Rec.progress         = _Entry;
+        return _Flush(&_Rec, sizeof(manifest_record));
+    }
+
+    inline manifest_status _To_manifest_status(const shred_status _Status) noexcept {
+        switch (_Status) {
+        case shred_status::success:
+            return manifest_status::shredded;
+        case shred_status::cannot_delete_file:
+            return manifest_status::not_deleted;
+        case shred_status::bad_file:
+            return manifest_status::cannot_open;
+        case shred_status::verification_failed:
+            return manifest_status::mismatch;
+        case shred_status::cancelled:
+            return manifest_status::cancelled;
+        default:
+            return manifest_status::cannot_shred;
+        }
+    }
+
+    void shred_manifest::finish(
+        const size_t _Slot, const shred_status _Status, const file_metadata& _Meta) noexcept {
+        if (!_Myview || _Slot >= size()) {
+            return;
+        }
+
+        manifest_record& _Rec = _Get_records()[_Slot];
+        _Rec.status           = static_cast<uint8_t>(::mjx::_To_manifest_status(_Status));
+        if (_Is_shredded(_Status)) { // a later run skips the file until it is written again
+            _Rec.progress.state      = journal_state::completed;
+            _Rec.progress.size       = _Meta.size;
+            _Rec.progress.last_write = _Meta.last_write;
+        }
+
+        _Flush(&_Rec, sizeof(manifest_record));
+    }
+
+    void shred_manifest::mark(const size_t _Slot, const manifest_status _Status) noexcept {
+        if (!_Myview || _Slot >= size()) {
+            return;
+        }
+
+        manifest_record& _Rec = _Get_records()[_Slot];
+        _Rec.status           = static_cast<uint8_t>(_Status);
+        _Flush(&_Rec, sizeof(manifest_record));
+    }
+} // namespace mjx
\ No newline at end of file
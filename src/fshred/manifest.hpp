@@ -0,0 +1,143 @@
+// manifest.hpp
+
+// Copyright (c) Mateusz Jandura. All rights reserved.
+// SPDX-License-Identifier: Apache-2.0
+
+#pragma once
+#ifndef _FSHRED_MANIFEST_HPP_
+#define _FSHRED_MANIFEST_HPP_
+#include <cstddef>
+#include <cstdint>
+#include <fshred/identity.hpp>
+#include <fshred/journal.hpp>
+#include <fshred/mapping.hpp>
+#include <mjfs/file.hpp>
+#include <mjfs/path.hpp>
+#include <mjmem/smart_pointer.hpp>
+#include <mjstr/string_view.hpp>
+
+namespace mjx {
+    // Note: A manifest is produced by another tool and consists of the header, the records and the string
+    //       table, in this order. All values are little-endian. The paths are stored in the string table
+    //       in UTF-16, without terminators. The records are updated in place, so the manifest also holds
+    //       the progress of every file and a later run resumes it.
+    struct manifest_header {
+        char magic[8]; // "FSHMNFST"
+        uint32_t version;
+        uint32_t record_size;
+        uint64_t record_count;
+        uint64_t records_offset; // offset of the first record, a multiple of the record size
+        uint64_t strings_offset; // offset of the string table, a multiple of two
+        uint64_t strings_size; // size of the string table in bytes
+        byte_t reserved[16];
+    };
+
+    static_assert(sizeof(manifest_header) == 64, "the header layout is a part of the format");
+
+    enum class manifest_flag : uint8_t {
+        delete_after_shredding = 0x01 // delete the file once shredded, regardless of the options
+    };
+
+    // Note: The status codes are a part of the format, so they never follow the internal results.
+    //       New codes may only be appended.
+    enum class manifest_status : uint8_t {
+        shredded     = 0, // overwritten, truncated and deleted if requested
+        not_deleted  = 1, // overwritten and truncated, but could not be deleted
+        cannot_open  = 2, // the file could not be opened or the record is damaged
+        cannot_shred = 3, // the data could not be overwritten
+        mismatch     = 4, // the data read back differs from the written pattern
+        cancelled    = 5, // stopped before the data was completely overwritten
+        skipped      = 6, // never shredded, the record lists the journal or the manifest itself
+        linked       = 7, // shredded through another path to the same file
+        pending      = 0xFF // not finished yet, set by the producer
+    };
+
+    struct manifest_record { // single file to shred
+        uint64_t path_offset; // offset of the path in the string table, in bytes
+        uint32_t path_length; // length of the path in UTF-16 units
+        uint8_t method; // shred_method, or shred_manifest::default_method
+        uint8_t flags; // combination of manifest_flag
+        uint8_t status; // manifest_status of the last run, written by the shredder
+        uint8_t reserved0;
+        byte_t reserved[16];
+        journal_entry progress; // written by the shredder, zeroed by the producer
+    };
+
+    static_assert(sizeof(manifest_record) == 64, "the record layout is a part of the format");
+
+    class shred_manifest : public shred_progress { // manifest mapped into memory, read without a copy
+    public:
+        shred_manifest() noexcept;
+        ~shred_manifest() noexcept override;
+
+        shred_manifest(const shred_manifest&)            = delete;
+        shred_manifest& operator=(const shred_manifest&) = delete;
+
+        static constexpr uint8_t default_method = 0xFF; // the file is shredded with the method of the options
+
+        // opens and validates the manifest
+        bool open(const path& _Target);
+
+        // checks whether the manifest is open
+        bool is_open() const noexcept;
+
+        // obtains the identifier of the manifest file
+        bool identify(file_id& _Id) const noexcept;
+
+        // returns the number of records
+        size_t size() const noexcept;
+
+        // returns the record, remains valid while the manifest is open
+        const manifest_record& record(const size_t _Slot) const noexcept;
+
+        // returns the path of the record, points into the string table, empty if the record is damaged
+        unicode_string_view target(const size_t _Slot) const noexcept;
+
+        // binds the record to the file, resets the progress recorded for another or an unidentified file
+        journal_entry attach(const size_t _Slot, const file_id& _Id) noexcept;
+
+        // binds the record in the slot to the file
+        journal_entry bind(size_t& _Slot, const file_id& _Id) override;
+
+        // returns the progress stored in the record
+        journal_entry read(const size_t _Slot) const noexcept override;
+
+        // stores the progress in the record and makes it durable
+        bool write(const size_t _Slot, const journal_entry& _Entry) noexcept override;
+
+        // stores the result in the record, marks a shredded file as completed
+        void finish(
+            const size_t _Slot, const shred_status _Status, const file_metadata& _Meta) noexcept override;
+
+        // stores the status of a record whose file is not shredded by this run
+        void mark(const size_t _Slot, const manifest_status _Status) noexcept;
+
+    private:
+        // releases the view and the mapping
+        void _Close() noexcept;
+
+        // checks whether the header describes ranges within the manifest
+        bool _Validate() const noexcept;
+
+        // writes the range of the view to the device
+        bool _Flush(const void* const _Data, const size_t _Size) noexcept;
+
+        // returns the header stored in the view
+        const manifest_header& _Get_header() const noexcept;
+
+        // returns the records stored in the view
+        manifest_record* _Get_records() const noexcept;
+
+        static constexpr char _Magic[8]    = {'F', 'S', 'H', 'M', 'N', 'F', 'S', 'T'};
+        static constexpr uint32_t _Version = 1;
+
+        // Note: Each worker writes only the record of its own file and the view never moves,
+        //       so no lock is needed.
+        file _Myfile;
+        unique_smart_ptr<_File_mapping> _Mymapping;
+        byte_t* _Myview;
+        size_t _Myview_size;
+    };
+} // namespace mjx
+
+#endif // _FSHRED_MANIFEST_HPP_
\ No newline at end of file
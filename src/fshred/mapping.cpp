@@ -0,0 +1,54 @@
+// mapping.cpp
+
+// Copyright (c) Mateusz Jandura. All rights reserved.
+// SPDX-License-Identifier: Apache-2.0
+
+#include <fshred/mapping.hpp>
+
+namespace mjx {
+    _File_mapping::_File_mapping(file& _File) noexcept
+        : _Myhandle(::CreateFileMappingW(_File.native_handle(), nullptr, PAGE_READWRITE, 0, 0, nullptr)) {}
+
+    _File_mapping::~_File_mapping() noexcept {
+        if (_Myhandle) {
+            ::CloseHandle(_Myhandle);
+            _Myhandle = nullptr;
+        }
+    }
+
+    bool _File_mapping::_Valid() const noexcept {
+        return _Myhandle != nullptr;
+    }
+
+    byte_t* _File_mapping::_Map(const uint64_t _Offset, const size_t _Size) noexcept {
+        return static_cast<byte_t*>(::MapViewOfFile(_Myhandle, FILE_MAP_WRITE,
+            static_cast<DWORD>(_Offset >> 32), static_cast<DWORD>(_Offset & 0xFFFF'FFFF), _Size));
+    }
+
+    bool _File_mapping::_Unmap(byte_t* const _View, const size_t _Size) noexcept {
+        // Note: FlushViewOfFile() only starts writing the dirty pages, it does not wait for them to
+        //       reach the device. They become durable only once the caller flushes the file after the
+        //       unmap, by flush_file_data() or FlushFileBuffers() in the durability barrier of the pass.
+        const bool _Flushed = ::FlushViewOfFile(_View, _Size) != 0;
+        return ::UnmapViewOfFile(_View) != 0 && _Flushed;
+    }
+
+    bool _Can_map_file(const file_metadata& _Meta) noexcept {
+        // Note: Writing to a mapping cannot report failures, an I/O error raises a structured exception
+        //       instead. Overwriting allocated clusters in place cannot run out of space, but sparse,
+        //       compressed and encrypted files may need new clusters, so they are written the usual way.
+        return ::mjx::has_plain_data(_Meta);
+    }
+
+    inline int _Filter_in_page_error(const unsigned long _Code) noexcept {
+        return _Code == EXCEPTION_IN_PAGE_ERROR ? EXCEPTION_EXECUTE_HANDLER : EXCEPTION_CONTINUE_SEARCH;
+    }
+
+    bool _Guard_mapped_access(const _Mapped_access_fn _Fn, void* const _Args) noexcept {
+        __try {
+            return _Fn(_Args);
+        } __except (::mjx::_Filter_in_page_error(GetExceptionCode())) { // the view is left partly filled
+            return false;
+        }
+    }
+} // namespace mjx
\ No newline at end of file
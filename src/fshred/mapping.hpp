@@ -0,0 +1,55 @@
+// mapping.hpp
+
+// Copyright (c) Mateusz Jandura. All rights reserved.
+// SPDX-License-Identifier: Apache-2.0
+
+#pragma once
+#ifndef _FSHRED_MAPPING_HPP_
+#define _FSHRED_MAPPING_HPP_
+#include <cstddef>
+#include <cstdint>
+#include <fshred/identity.hpp>
+#include <fshred/tinywin.hpp>
+#include <mjfs/file.hpp>
+#include <mjstr/char_traits.hpp>
+
+namespace mjx {
+    class _File_mapping { // read-write mapping of an entire file
+    public:
+        explicit _File_mapping(file& _File) noexcept;
+        ~_File_mapping() noexcept;
+
+        _File_mapping(const _File_mapping&)            = delete;
+        _File_mapping& operator=(const _File_mapping&) = delete;
+
+        // checks whether the mapping has been created
+        bool _Valid() const noexcept;
+
+        // maps the specified range of the file, the offset must be a multiple of the granularity
+        byte_t* _Map(const uint64_t _Offset, const size_t _Size) noexcept;
+
+        // starts writing the mapped range back to the file and unmaps it, a flush makes it durable
+        static bool _Unmap(byte_t* const _View, const size_t _Size) noexcept;
+
+        // Note: The window is a multiple of the allocation granularity (64 KiB), so it can be used
+        //       as an offset. It is small enough to be mapped in a 32-bit address space.
+        static constexpr size_t _Window_size = 64 * 1024 * 1024;
+        static constexpr size_t _Granularity = 64 * 1024;
+
+    private:
+        HANDLE _Myhandle;
+    };
+
+    // checks whether the file can be safely shredded through a mapping
+    bool _Can_map_file(const file_metadata& _Meta) noexcept;
+
+    // Note: An I/O error of a mapped page raises EXCEPTION_IN_PAGE_ERROR instead of failing a call.
+    //       A structured exception handler cannot share a function with objects that need unwinding,
+    //       so the code that touches the view is passed to a small guard as a plain function.
+    using _Mapped_access_fn = bool (*)(void* const _Args) noexcept;
+
+    // calls the function, fails instead of crashing if a mapped page could not be read or written
+    bool _Guard_mapped_access(const _Mapped_access_fn _Fn, void* const _Args) noexcept;
+} // namespace mjx
+
+#endif // _FSHRED_MAPPING_HPP_
\ No newline at end of file
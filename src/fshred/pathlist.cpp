@@ -0,0 +1,151 @@
+// pathlist.cpp
+
+// Copyright (c) Mateusz Jandura. All rights reserved.
+// SPDX-License-Identifier: Apache-2.0
+
+#include <cstring>
+#include <fshred/pathlist.hpp>
+#include <mjstr/conversion.hpp>
+#include <mjstr/string_view.hpp>
+
+namespace mjx {
+    path_list::path_list() noexcept
+        : _Myhandle(INVALID_HANDLE_VALUE), _Myowned(false), _Myfailed(false), _Myfirst(true), _Myblock(),
+        _Mypos(0), _Mysize(0), _Myentry(), _Mytoo_long(false) {}
+
+    path_list::~path_list() noexcept {
+        _Close();
+    }
+
+    void path_list::_Close() noexcept {
+        if (_Myhandle != INVALID_HANDLE_VALUE && _Myowned) {
+            ::CloseHandle(_Myhandle);
+        }
+
+        _Myhandle = INVALID_HANDLE_VALUE;
+        _Myowned  = false;
+    }
+
+    bool path_list::open(const path& _Source) {
+        _Close();
+        if (!_Myblock) {
+            _Myblock = ::mjx::make_unique_smart_array<char>(_Block_size);
+        }
+
+        if (_Source.native() == L"-") { // the list is piped or redirected to the standard input
+            _Myhandle = ::GetStdHandle(STD_INPUT_HANDLE);
+            _Myowned  = false;
+        } else {
+            _Myhandle = ::CreateFileW(_Source.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr,
+                OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+            _Myowned  = true;
+        }
+
+        if (_Myhandle == nullptr || _Myhandle == INVALID_HANDLE_VALUE) { // no standard input or no file
+            _Myhandle = INVALID_HANDLE_VALUE;
+            _Myowned  = false;
+            return false;
+        }
+
+        _Myfailed   = false;
+        _Myfirst    = true;
+        _Mypos      = 0;
+        _Mysize     = 0;
+        _Mytoo_long = false;
+        _Myentry.clear();
+        return true;
+    }
+
+    bool path_list::failed() const noexcept {
+        return _Myfailed;
+    }
+
+    bool path_list::_Fill() noexcept {
+        if (_Myhandle == INVALID_HANDLE_VALUE) { // closed or already at the end
+            return false;
+        }
+
+        DWORD _Read = 0;
+        if (!::ReadFile(_Myhandle, _Myblock.get(), static_cast<DWORD>(_Block_size), &_Read, nullptr)) {
+            // a closed pipe marks the end of the list, anything else is a failure
+            _Myfailed = ::GetLastError() != ERROR_BROKEN_PIPE;
+            _Close();
+            return false;
+        }
+
+        if (_Read == 0) { // end of the list
+            _Close();
+            return false;
+        }
+
+        _Mypos  = 0;
+        _Mysize = static_cast<size_t>(_Read);
+        return true;
+    }
+
+    void path_list::_Trim() noexcept {
+        if (_Myfirst) { // the list may start with the UTF-8 byte order mark
+            _Myfirst = false;
+            if (_Myentry.size() >= 3 && ::memcmp(_Myentry.data(), "\xEF\xBB\xBF", 3) == 0) {
+                _Myentry.erase(0, 3);
+            }
+        }
+
+        if (!_Myentry.empty() && _Myentry.back() == '\r') { // the list may use Windows line endings
+            _Myentry.pop_back();
+        }
+    }
+
+    bool path_list::next(path& _Path) {
+        // Note: Only a single entry is kept in memory besides the block, so a list of any length
+        //       is read in constant memory. Each path can be shredded before the next one is read.
+        const char* _Block;
+        const char* _First;
+        const char* _Last;
+        const char* _End;
+        size_t _Length;
+        for (;;) {
+            if (_Mypos == _Mysize && !_Fill()) { // the last entry may not be terminated
+                _Trim();
+                if (_Myentry.empty() && !_Mytoo_long) {
+                    return false;
+                }
+
+                break;
+            }
+
+            _Block = _Myblock.get();
+            _First = _Block + _Mypos;
+            _End   = _Block + _Mysize;
+            for (_Last = _First; _Last != _End && *_Last != '\n' && *_Last != '\0'; ++_Last) {}
+
+            _Length = static_cast<size_t>(_Last - _First);
+            if (_Mytoo_long || _Myentry.size() + _Length > _Max_entry_size) {
+                _Mytoo_long = true;
+            } else {
+                _Myentry.append(_First, _Length);
+            }
+
+            _Mypos = static_cast<size_t>(_Last - _Block);
+            if (_Last == _End) { // the entry continues in the next block
+                continue;
+            }
+
+            ++_Mypos; // skip the separator
+            _Trim();
+            if (!_Myentry.empty() || _Mytoo_long) { // skip empty lines
+                break;
+            }
+        }
+
+        if (_Mytoo_long) { // cannot be opened, let the caller report it
+            _Path = path{};
+        } else {
+            _Path = path{::mjx::to_unicode_string(utf8_string_view{_Myentry.data(), _Myentry.size()})};
+        }
+
+        _Myentry.clear();
+        _Mytoo_long = false;
+        return true;
+    }
+} // namespace mjx
\ No newline at end of file
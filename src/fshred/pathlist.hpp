@@ -0,0 +1,60 @@
+// pathlist.hpp
+
+// Copyright (c) Mateusz Jandura. All rights reserved.
+// SPDX-License-Identifier: Apache-2.0
+
+#pragma once
+#ifndef _FSHRED_PATHLIST_HPP_
+#define _FSHRED_PATHLIST_HPP_
+#include <cstddef>
+#include <fshred/tinywin.hpp>
+#include <mjfs/path.hpp>
+#include <mjmem/smart_pointer.hpp>
+#include <mjstr/string.hpp>
+
+namespace mjx {
+    class path_list { // streams the paths listed in a file or on the standard input
+    public:
+        path_list() noexcept;
+        ~path_list() noexcept;
+
+        path_list(const path_list&)            = delete;
+        path_list& operator=(const path_list&) = delete;
+
+        // opens the list, "-" stands for the standard input
+        bool open(const path& _Source);
+
+        // reads the next path, returns false at the end of the list
+        bool next(path& _Path);
+
+        // checks whether the list could not be read to the end
+        bool failed() const noexcept;
+
+    private:
+        // reads the next block of the list, returns false at the end of the list
+        bool _Fill() noexcept;
+
+        // closes the list, the standard input remains open
+        void _Close() noexcept;
+
+        // removes the byte order mark and the carriage return from the current entry
+        void _Trim() noexcept;
+
+        // Note: Paths are separated by a new line or a null character, neither of which may appear
+        //       in a Windows path. The longest path has 32767 UTF-16 units, up to three UTF-8 bytes each.
+        static constexpr size_t _Block_size     = 64 * 1024;
+        static constexpr size_t _Max_entry_size = 32767 * 3;
+
+        HANDLE _Myhandle;
+        bool _Myowned; // the standard input is not closed
+        bool _Myfailed;
+        bool _Myfirst; // the list may start with a byte order mark
+        unique_smart_array<char> _Myblock;
+        size_t _Mypos; // next unread byte of the block
+        size_t _Mysize; // number of valid bytes in the block
+        utf8_string _Myentry; // entry that spans several blocks
+        bool _Mytoo_long; // the current entry cannot be a valid path
+    };
+} // namespace mjx
+
+#endif // _FSHRED_PATHLIST_HPP_
\ No newline at end of file
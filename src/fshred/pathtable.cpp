@@ -0,0 +1,124 @@
+// pathtable.cpp
+
+// Copyright (c) Mateusz Jandura. All rights reserved.
+// SPDX-License-Identifier: Apache-2.0
+
+#include <algorithm>
+#include <cstring>
+#include <fshred/pathtable.hpp>
+#include <mjstr/string.hpp>
+#include <new>
+
+namespace mjx {
+    path_table::path_table() noexcept : _Mynodes(), _Mylast(), _Myblocks(), _Myblock_used(0) {}
+
+    path_table::~path_table() noexcept {}
+
+    inline bool _Is_path_separator(const wchar_t _Ch) noexcept {
+        return _Ch == L'\\' || _Ch == L'/';
+    }
+
+    const wchar_t* path_table::_Store(const unicode_string_view _Name) {
+        if (_Name.empty()) { // the root of a UNC path or a trailing separator
+            return nullptr;
+        }
+
+        const size_t _Bytes = _Name.size() * sizeof(wchar_t);
+        if (_Myblocks.empty() || _Myblocks.back().size() - _Myblock_used < _Bytes) { // start a new block
+            _Myblocks.emplace_back((::std::max)(_Bytes, _Block_size));
+            _Myblock_used = 0;
+        }
+
+        wchar_t* const _Ptr =
+            reinterpret_cast<wchar_t*>(static_cast<char*>(_Myblocks.back().data()) + _Myblock_used);
+        ::memcpy(_Ptr, _Name.data(), _Bytes);
+        _Myblock_used += _Bytes;
+        return _Ptr;
+    }
+
+    path_table::index_type path_table::insert(const path& _Target) {
+        // Note: Empty components are stored as well, so that the path is rebuilt exactly as given,
+        //       including the leading separators of UNC paths.
+        const unicode_string& _Str     = _Target.native();
+        size_t _Depth                  = 0;
+        size_t _First                  = 0;
+        bool _Matching                 = true;
+        index_type _Parent             = npos;
+        for (size_t _Pos = 0; _Pos <= _Str.size(); ++_Pos) {
+            if (_Pos < _Str.size() && !_Is_path_separator(_Str[_Pos])) {
+                continue;
+            }
+
+            const unicode_string_view _Name(_Str.data() + _First, _Pos - _First);
+            _First = _Pos + 1;
+            if (_Matching && _Depth < _Mylast.size()) {
+                const _Node& _Last = _Mynodes[_Mylast[_Depth]];
+                if (_Last._Length == _Name.size()
+                    && ::memcmp(_Last._Name, _Name.data(), _Name.size() * sizeof(wchar_t)) == 0) {
+                    _Parent = _Mylast[_Depth++];
+                    continue; // shared with the last path
+                }
+            }
+
+            if (_Matching) { // the rest of the last path is not shared
+                _Mylast.resize(_Depth);
+                _Matching = false;
+            }
+
+            if (_Mynodes.size() >= npos) { // no more indexes
+                throw ::std::bad_alloc{};
+            }
+
+            _Mynodes.push_back(_Node{_Store(_Name), _Parent, static_cast<uint32_t>(_Name.size())});
+            _Parent = static_cast<index_type>(_Mynodes.size() - 1);
+            _Mylast.push_back(_Parent);
+            ++_Depth;
+        }
+
+        if (_Matching) { // the same path or a prefix of the last path
+            _Mylast.resize(_Depth);
+        }
+
+        return _Parent;
+    }
+
+    path path_table::at(const index_type _Idx) const {
+        size_t _Length = 0;
+        size_t _Count  = 0;
+        for (index_type _Node_idx = _Idx; _Node_idx != npos; _Node_idx = _Mynodes[_Node_idx]._Parent) {
+            _Length += _Mynodes[_Node_idx]._Length;
+            ++_Count;
+        }
+
+        if (_Count == 0) {
+            return path{};
+        }
+
+        unicode_string _Str(_Length + _Count - 1, L'\\'); // components joined by separators
+        size_t _End = _Str.size();
+        for (index_type _Node_idx = _Idx; _Node_idx != npos; _Node_idx = _Mynodes[_Node_idx]._Parent) {
+            const _Node& _Comp = _Mynodes[_Node_idx];
+            _End              -= _Comp._Length;
+            if (_Comp._Length > 0) {
+                ::memcpy(_Str.data() + _End, _Comp._Name, _Comp._Length * sizeof(wchar_t));
+            }
+
+            if (_End > 0) { // skip the separator
+                --_End;
+            }
+        }
+
+        return path{::std::move(_Str), path::native_format};
+    }
+
+    size_t path_table::size() const noexcept {
+        return _Mynodes.size();
+    }
+
+    void path_table::clear() noexcept {
+        _Mynodes.clear();
+        _Mylast.clear();
+        _Myblocks.clear();
+        _Myblock_used = 0;
+    }
+} // namespace mjx
\ No newline at end of file
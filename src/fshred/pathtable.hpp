@@ -0,0 +1,65 @@
+// pathtable.hpp
+
+// Copyright (c) Mateusz Jandura. All rights reserved.
+// SPDX-License-Identifier: Apache-2.0
+
+#pragma once
+#ifndef _FSHRED_PATHTABLE_HPP_
+#define _FSHRED_PATHTABLE_HPP_
+#include <cstddef>
+#include <cstdint>
+#include <mjfs/path.hpp>
+#include <mjmem/pool_resource.hpp>
+#include <mjstr/string_view.hpp>
+#include <vector>
+
+namespace mjx {
+    class path_table { // compact storage of many paths that share their prefixes
+    public:
+        using index_type = uint32_t;
+
+        path_table() noexcept;
+        ~path_table() noexcept;
+
+        path_table(const path_table&)            = delete;
+        path_table& operator=(const path_table&) = delete;
+
+        static constexpr index_type npos = static_cast<index_type>(-1);
+
+        // stores the path, returns its index
+        index_type insert(const path& _Target);
+
+        // rebuilds the path stored under the index
+        path at(const index_type _Idx) const;
+
+        // returns the number of stored components
+        size_t size() const noexcept;
+
+        // releases all paths
+        void clear() noexcept;
+
+    private:
+        struct _Node { // single component, linked to its parent
+            const wchar_t* _Name; // stored in the arena, not terminated
+            index_type _Parent;
+            uint32_t _Length;
+        };
+
+        // copies the component into the arena
+        const wchar_t* _Store(const unicode_string_view _Name);
+
+        // Note: Every component is stored once per parent and points to it, so a path costs a single
+        //       node per component that differs from the previous path. Paths come from directory walks
+        //       and lists, where neighbouring paths share their prefixes, so only the components of the
+        //       last path are matched, no lookup structure is needed. The names are copied into large
+        //       blocks of the arena instead of a heap allocation each.
+        static constexpr size_t _Block_size = 64 * 1024;
+
+        ::std::vector<_Node> _Mynodes;
+        ::std::vector<index_type> _Mylast; // nodes of the last inserted path, from the root
+        ::std::vector<pool_resource> _Myblocks;
+        size_t _Myblock_used; // number of bytes used in the last block
+    };
+} // namespace mjx
+
+#endif // _FSHRED_PATHTABLE_HPP_
\ No newline at end of file
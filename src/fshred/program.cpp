@@ -5,13 +5,18 @@
 
 #include <fshred/program.hpp>
 #include <fshred/tinywin.hpp>
+#include <limits>
 #include <mjfs/status.hpp>
 #include <mjstr/string_view.hpp>
 #include <shellapi.h>
 
 namespace mjx {
     program_options::program_options() noexcept
-        : path_to_file(), delete_after_shredding(false), confirmation_required(true) {}
+        : targets(), list_path(), manifest_path(), delete_after_shredding(false), confirmation_required(true),
+        max_concurrency(0), queue_depth(0), buffer_count(32), global_io_limits{0, 0}, device_io_limits{0, 0},
+        report_path(), certificate_path(), journal_path(), cancel_event(),
+        min_mapped_size((::std::numeric_limits<uint64_t>::max)()),
+        settings(::mjx::default_shred_settings()) {}
 
     program_options::~program_options() noexcept {}
 
@@ -30,38 +35,233 @@ namespace mjx {
         _Args = ::CommandLineToArgvW(_Combined_args, &_Count);
     }
 
-    void program_args::parse(program_args& _Args, program_options& _Options) {
-        bool _Path_found        = false;
-        bool _Delete_flag_found = false;
-        bool _Nc_flag_found     = false;
-        int _Count              = _Args.count();
-        wchar_t** _Raw_args     = _Args.args();
-        unicode_string_view _Arg;
-        for (; _Count-- > 0 && (!_Path_found || !_Delete_flag_found || !_Nc_flag_found); ++_Raw_args) {
-            _Arg = *_Raw_args;
-            if (!_Path_found) {
-                if (::mjx::exists(_Arg)) {
-                    _Options.path_to_file = _Arg;
-                    _Path_found           = true;
-                    continue;
-                }
+    bool program_args::_Parse_number(const unicode_string_view _Arg, uint64_t& _Num) noexcept {
+        if (_Arg.empty()) {
+            return false;
+        }
+
+        uint64_t _Multiplier = 1;
+        size_t _Digits       = _Arg.size();
+        switch (_Arg.back()) {
+        case L'K':
+        case L'k':
+            _Multiplier = 1ULL << 10;
+            --_Digits;
+            break;
+        case L'M':
+        case L'm':
+            _Multiplier = 1ULL << 20;
+            --_Digits;
+            break;
+        case L'G':
+        case L'g':
+            _Multiplier = 1ULL << 30;
+            --_Digits;
+            break;
+        default:
+            break;
+        }
+
+        if (_Digits == 0) { // suffix without a number
+            return false;
+        }
+
+        constexpr uint64_t _Max_val = (::std::numeric_limits<uint64_t>::max)();
+        uint64_t _Val               = 0;
+        uint64_t _Digit;
+        for (size_t _Idx = 0; _Idx < _Digits; ++_Idx) {
+            if (_Arg[_Idx] < L'0' || _Arg[_Idx] > L'9') {
+                return false;
             }
 
-            if (!_Delete_flag_found) {
-                if (_Arg == L"-d") {
-                    _Options.delete_after_shredding = true;
-                    _Delete_flag_found              = true;
-                    continue;
-                }
+            _Digit = static_cast<uint64_t>(_Arg[_Idx] - L'0');
+            if (_Val > (_Max_val - _Digit) / 10) { // too large
+                return false;
             }
 
-            if (!_Nc_flag_found) {
-                if (_Arg == L"-nc") {
-                    _Options.confirmation_required = false;
-                    _Nc_flag_found                 = true;
+            _Val = _Val * 10 + _Digit;
+        }
+
+        if (_Val > _Max_val / _Multiplier) { // too large with the suffix
+            return false;
+        }
+
+        _Num = _Val * _Multiplier;
+        return true;
+    }
+
+    template <class _Ty>
+    bool program_args::_Take_number(
+        int& _Count, wchar_t**& _Raw_args, _Ty& _Num, const uint64_t _Min, const uint64_t _Max) noexcept {
+        uint64_t _Val;
+        if (_Count <= 0 || !_Parse_number(_Raw_args[1], _Val)) { // no valid value follows the option
+            return false;
+        }
+
+        if (_Val < _Min || _Val > _Max
+            || _Val > static_cast<uint64_t>((::std::numeric_limits<_Ty>::max)())) { // out of range
+            return false;
+        }
+
+        _Num = static_cast<_Ty>(_Val);
+        --_Count;
+        ++_Raw_args;
+        return true;
+    }
+
+    bool program_args::_Take_path(int& _Count, wchar_t**& _Raw_args, path& _Path) {
+        if (_Count <= 0) { // no value follows the option
+            return false;
+        }
+
+        _Path = unicode_string_view{_Raw_args[1]};
+        --_Count;
+        ++_Raw_args;
+        return true;
+    }
+
+    bool program_args::_Take_string(int& _Count, wchar_t**& _Raw_args, unicode_string& _Str) {
+        if (_Count <= 0) { // no value follows the option
+            return false;
+        }
+
+        _Str = _Raw_args[1];
+        --_Count;
+        ++_Raw_args;
+        return true;
+    }
+
+    bool program_args::_Take_method(int& _Count, wchar_t**& _Raw_args, shred_method& _Method) noexcept {
+        if (_Count <= 0) { // no value follows the option
+            return false;
+        }
+
+        const unicode_string_view _Name = _Raw_args[1];
+        if (_Name == L"dod") {
+            _Method = shred_method::dod_5220_22_m_ece;
+        } else if (_Name == L"clear") {
+            _Method = shred_method::nist_800_88_clear;
+        } else { // unknown method, keep the current one
+            return false;
+        }
+
+        --_Count;
+        ++_Raw_args;
+        return true;
+    }
+
+    bool program_args::_Take_durability(
+        int& _Count, wchar_t**& _Raw_args, durability_policy& _Policy) noexcept {
+        if (_Count <= 0) { // no value follows the option
+            return false;
+        }
+
+        const unicode_string_view _Name = _Raw_args[1];
+        if (_Name == L"flush") {
+            _Policy = durability_policy::flush_per_pass;
+        } else if (_Name == L"data") {
+            _Policy = durability_policy::data_flush_per_pass;
+        } else if (_Name == L"wt") {
+            _Policy = durability_policy::write_through;
+        } else if (_Name == L"group") {
+            _Policy = durability_policy::flush_per_group;
+        } else { // unknown policy, keep the current one
+            return false;
+        }
+
+        --_Count;
+        ++_Raw_args;
+        return true;
+    }
+
+    bool program_args::_Take_verify_mode(int& _Count, wchar_t**& _Raw_args, verify_mode& _Mode) noexcept {
+        if (_Count <= 0) { // no value follows the option
+            return false;
+        }
+
+        const unicode_string_view _Name = _Raw_args[1];
+        if (_Name == L"final") {
+            _Mode = verify_mode::final_pass;
+        } else if (_Name == L"every") {
+            _Mode = verify_mode::every_pass;
+        } else { // unknown mode, keep the current one
+            return false;
+        }
+
+        --_Count;
+        ++_Raw_args;
+        return true;
+    }
+
+    bool program_args::parse(program_args& _Args, program_options& _Options) {
+        int _Count          = _Args.count();
+        wchar_t** _Raw_args = _Args.args();
+        bool _Valid         = true; // a missing or invalid value fails the whole command
+        unicode_string_view _Arg;
+        for (; _Count-- > 0; ++_Raw_args) {
+            _Arg = *_Raw_args;
+            if (_Arg == L"-d") {
+                _Options.delete_after_shredding = true;
+            } else if (_Arg == L"-nc") {
+                _Options.confirmation_required = false;
+            } else if (_Arg == L"-m") {
+                _Valid &= _Take_method(_Count, _Raw_args, _Options.settings.method);
+            } else if (_Arg == L"-j") {
+                _Valid &= _Take_number(_Count, _Raw_args, _Options.max_concurrency);
+            } else if (_Arg == L"-qd") {
+                _Valid &= _Take_number(_Count, _Raw_args, _Options.queue_depth);
+            } else if (_Arg == L"-buffers") {
+                _Valid &= _Take_number(_Count, _Raw_args, _Options.buffer_count);
+            } else if (_Arg == L"-bw") {
+                _Valid &= _Take_number(_Count, _Raw_args, _Options.global_io_limits.bytes_per_second);
+            } else if (_Arg == L"-iops") {
+                _Valid &= _Take_number(_Count, _Raw_args, _Options.global_io_limits.writes_per_second);
+            } else if (_Arg == L"-dbw") {
+                _Valid &= _Take_number(_Count, _Raw_args, _Options.device_io_limits.bytes_per_second);
+            } else if (_Arg == L"-diops") {
+                _Valid &= _Take_number(_Count, _Raw_args, _Options.device_io_limits.writes_per_second);
+            } else if (_Arg == L"-wb") {
+                _Valid &= _Take_number(_Count, _Raw_args, _Options.settings.write_behind_window);
+            } else if (_Arg == L"-mmap") {
+                _Valid &= _Take_number(_Count, _Raw_args, _Options.min_mapped_size);
+            } else if (_Arg == L"-nocache") {
+                _Options.settings.bypass_cache = true;
+            } else if (_Arg == L"-dur") {
+                _Valid &= _Take_durability(_Count, _Raw_args, _Options.settings.durability);
+            } else if (_Arg == L"-group") {
+                _Valid &= _Take_number(_Count, _Raw_args, _Options.settings.barrier_group_size);
+            } else if (_Arg == L"-coverage") {
+                _Valid &= _Take_number(_Count, _Raw_args, _Options.settings.verify_coverage, 1, 100);
+            } else if (_Arg == L"-seed") {
+                _Options.settings.seeded_random = true;
+            } else if (_Arg == L"-verify") {
+                _Valid &= _Take_verify_mode(_Count, _Raw_args, _Options.settings.verification);
+            } else if (_Arg == L"-report") {
+                _Valid &= _Take_path(_Count, _Raw_args, _Options.report_path);
+            } else if (_Arg == L"-cert") {
+                if (_Take_path(_Count, _Raw_args, _Options.certificate_path)) { // certificates need digests
+                    _Options.settings.hash_passes = true;
+                } else {
+                    _Valid = false;
                 }
+            } else if (_Arg == L"-journal") {
+                _Valid &= _Take_path(_Count, _Raw_args, _Options.journal_path);
+            } else if (_Arg == L"-list") {
+                _Valid &= _Take_path(_Count, _Raw_args, _Options.list_path);
+            } else if (_Arg == L"-manifest") {
+                _Valid &= _Take_path(_Count, _Raw_args, _Options.manifest_path);
+            } else if (_Arg == L"-cancel") {
+                _Valid &= _Take_string(_Count, _Raw_args, _Options.cancel_event);
+            } else if (::mjx::exists(_Arg)) { // every existing path is a target
+                _Options.targets.emplace_back(_Arg);
             }
         }
+
+        if (_Options.settings.verification != verify_mode::none) { // random passes must be reproducible
+            _Options.settings.seeded_random = true;
+        }
+
+        return _Valid;
     }
 
     wchar_t** program_args::args() const noexcept {
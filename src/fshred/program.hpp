@@ -6,14 +6,35 @@
 #pragma once
 #ifndef _FSHRED_PROGRAM_HPP_
 #define _FSHRED_PROGRAM_HPP_
+#include <cstddef>
+#include <cstdint>
+#include <fshred/shredder.hpp>
+#include <fshred/throttle.hpp>
+#include <limits>
 #include <mjfs/path.hpp>
+#include <mjstr/string.hpp>
+#include <mjstr/string_view.hpp>
+#include <vector>
 
 namespace mjx {
     class program_options {
     public:
-        path path_to_file;
+        ::std::vector<path> targets; // files and directories to shred
+        path list_path; // file that lists further targets, "-" for the standard input, empty if none
+        path manifest_path; // binary manifest of further targets and their progress, empty if none
         bool delete_after_shredding;
         bool confirmation_required;
+        size_t max_concurrency; // files shredded at once per device, 0 if detected
+        size_t queue_depth; // files waiting for a worker of any device, 0 for the default
+        size_t buffer_count; // write buffers allocated at startup, 0 if disabled
+        io_limits global_io_limits; // write limits shared by all devices
+        io_limits device_io_limits; // write limits of each device
+        path report_path; // where to write the report, empty if not requested
+        path certificate_path; // where to write the erasure certificates, empty if not requested
+        path journal_path; // where to record the progress, empty if not requested
+        unicode_string cancel_event; // name of the event that stops the batch, empty if not requested
+        uint64_t min_mapped_size; // files of at least this size are mapped, the maximum if none
+        shred_settings settings; // applied to every shredded file
 
         program_options() noexcept;
         ~program_options() noexcept;
@@ -24,8 +45,8 @@ namespace mjx {
         explicit program_args(wchar_t* const _Combined_args) noexcept;
         ~program_args() noexcept;
 
-        // parses program arguments
-        static void parse(program_args& _Args, program_options& _Options);
+        // parses program arguments, returns false if the value of an option is missing or invalid
+        static bool parse(program_args& _Args, program_options& _Options);
 
         // returns the arguments
         wchar_t** args() const noexcept;
@@ -34,6 +55,29 @@ namespace mjx {
         const int count() const noexcept;
 
     private:
+        // converts a decimal argument with an optional K/M/G suffix to a number
+        static bool _Parse_number(const unicode_string_view _Arg, uint64_t& _Num) noexcept;
+
+        // consumes the argument that follows an option as a number within the range
+        template <class _Ty>
+        static bool _Take_number(int& _Count, wchar_t**& _Raw_args, _Ty& _Num, const uint64_t _Min = 0,
+            const uint64_t _Max = (::std::numeric_limits<uint64_t>::max)()) noexcept;
+
+        // consumes the argument that follows an option as a path
+        static bool _Take_path(int& _Count, wchar_t**& _Raw_args, path& _Path);
+
+        // consumes the argument that follows an option as a string
+        static bool _Take_string(int& _Count, wchar_t**& _Raw_args, unicode_string& _Str);
+
+        // consumes the argument that follows an option as a shredding method
+        static bool _Take_method(int& _Count, wchar_t**& _Raw_args, shred_method& _Method) noexcept;
+
+        // consumes the argument that follows an option as a durability policy
+        static bool _Take_durability(int& _Count, wchar_t**& _Raw_args, durability_policy& _Policy) noexcept;
+
+        // consumes the argument that follows an option as a verification mode
+        static bool _Take_verify_mode(int& _Count, wchar_t**& _Raw_args, verify_mode& _Mode) noexcept;
+
         // splits combined arguments
         static void _Split(wchar_t* const _Combined_args, int& _Count, wchar_t**& _Args) noexcept;
 
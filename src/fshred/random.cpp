@@ -3,9 +3,14 @@
 // Copyright (c) Mateusz Jandura. All rights reserved.
 // SPDX-License-Identifier: Apache-2.0
 
+#include <algorithm>
+#include <cstring>
+#include <fshred/kernels.hpp>
 #include <fshred/random.hpp>
 #include <fshred/tinywin.hpp>
 #include <fshred/utils.hpp>
+#include <thread>
+#include <utility>
 #include <bcrypt.h> // include after <Windows.h>
 
 namespace mjx {
@@ -15,4 +20,185 @@ namespace mjx {
         return _Func ? _Func(nullptr, _Buf, static_cast<unsigned long>(_Count),
             BCRYPT_USE_SYSTEM_PREFERRED_RNG) == 0 : false;
     }
+
+    _Entropy_cache::_Entropy_cache() noexcept
+        : _Myblock(), _Myspare(), _Mypos(0), _Myrefill(), _Myresult(true) {}
+
+    _Entropy_cache::~_Entropy_cache() noexcept {
+        // Note: The cache is destroyed when its thread exits, with the loader lock held. The refill
+        //       thread needs that lock to exit, so it cannot be joined. Instead, the pending refill
+        //       is awaited, so that the spare block can be freed, and the thread is left to exit
+        //       on its own, sharing the state it still uses.
+        if (_Myrefill) {
+            _Wait();
+            {
+                ::std::lock_guard<::std::mutex> _Guard(_Myrefill->_Mtx);
+                _Myrefill->_Stopping = true;
+            }
+
+            _Myrefill->_State_changed.notify_all();
+        }
+    }
+
+    bool _Entropy_cache::_Allocate() noexcept {
+        try {
+            _Myblock = ::mjx::make_unique_smart_array<byte_t>(_Block_size);
+            _Myspare = ::mjx::make_unique_smart_array<byte_t>(_Block_size);
+        } catch (...) { // not enough memory, the cache cannot be used
+            _Myblock = nullptr;
+            _Myspare = nullptr;
+            return false;
+        }
+
+        if (!fill_with_random_bytes(_Myblock.get(), _Block_size)) {
+            _Myblock = nullptr;
+            _Myspare = nullptr;
+            return false;
+        }
+
+        _Mypos = 0;
+        _Start_refill();
+        return true;
+    }
+
+    void _Entropy_cache::_Run(const smart_ptr<_Refill_state> _State) noexcept {
+        bool _Filled;
+        ::std::unique_lock<::std::mutex> _Lock(_State->_Mtx);
+        for (;;) {
+            _State->_State_changed.wait(_Lock, [&_State] {
+                return _State->_Refilling || _State->_Stopping;
+            });
+            if (!_State->_Refilling) { // stopped, nothing to refill
+                return;
+            }
+
+            _Lock.unlock();
+            _Filled = fill_with_random_bytes(_State->_Block, _Block_size);
+            _Lock.lock();
+            _State->_Result    = _State->_Result && _Filled;
+            _State->_Refilling = false;
+            _State->_State_changed.notify_all();
+        }
+    }
+
+    void _Entropy_cache::_Start_refill() noexcept {
+        if (!_Myrefill) { // start the refill thread, it serves the cache until it is destroyed
+            try {
+                smart_ptr<_Refill_state> _State = ::mjx::make_smart_ptr<_Refill_state>();
+                _State->_Block                  = nullptr;
+                _State->_Refilling              = false;
+                _State->_Stopping               = false;
+                _State->_Result                 = true;
+                ::std::thread(&_Entropy_cache::_Run, _State).detach();
+                _Myrefill = ::std::move(_State);
+            } catch (...) { // could not start the thread, refill the block synchronously
+                _Myresult = fill_with_random_bytes(_Myspare.get(), _Block_size);
+                return;
+            }
+        }
+
+        {
+            ::std::lock_guard<::std::mutex> _Guard(_Myrefill->_Mtx);
+            _Myrefill->_Block     = _Myspare.get();
+            _Myrefill->_Refilling = true;
+        }
+
+        _Myrefill->_State_changed.notify_all();
+    }
+
+    bool _Entropy_cache::_Wait() noexcept {
+        bool _Result = _Myresult;
+        if (_Myrefill) {
+            ::std::unique_lock<::std::mutex> _Lock(_Myrefill->_Mtx);
+            _Myrefill->_State_changed.wait(_Lock, [this] { return !_Myrefill->_Refilling; });
+            _Result            = _Result && _Myrefill->_Result;
+            _Myrefill->_Result = true;
+        }
+
+        _Myresult = true;
+        return _Result;
+    }
+
+    bool _Entropy_cache::_Swap() noexcept {
+        // Note: The spare block is served only after a successful refill, otherwise the bytes it holds
+        //       would be served twice. A failed refill is retried synchronously and, if it fails again,
+        //       remembered, so that the next attempt retries it as well.
+        if (!_Wait() && !fill_with_random_bytes(_Myspare.get(), _Block_size)) {
+            _Myresult = false;
+            return false;
+        }
+
+        _Myblock.swap(_Myspare);
+        _Mypos = 0;
+        _Start_refill();
+        return true;
+    }
+
+    bool _Entropy_cache::_Read(byte_t* const _Buf, const size_t _Count) noexcept {
+        if (_Count >= _Block_size) { // large request, a single call is as cheap as the cache
+            return fill_with_random_bytes(_Buf, _Count);
+        }
+
+        if (!_Myblock && !_Allocate()) { // the cache is unavailable, use the generator directly
+            return fill_with_random_bytes(_Buf, _Count);
+        }
+
+        size_t _Chunk_size;
+        for (size_t _Off = 0; _Off < _Count; _Off += _Chunk_size) {
+            if (_Mypos == _Block_size && !_Swap()) {
+                return false;
+            }
+
+            _Chunk_size = (::std::min)(_Block_size - _Mypos, _Count - _Off);
+            ::memcpy(_Buf + _Off, _Myblock.get() + _Mypos, _Chunk_size);
+            _Mypos += _Chunk_size;
+        }
+
+        return true;
+    }
+
+    bool fill_with_cached_random_bytes(byte_t* const _Buf, const size_t _Count) noexcept {
+        // Note: Each thread has its own cache, so that the workers do not contend for a lock.
+        //       The blocks are allocated by the first request, threads that never need random bytes
+        //       do not pay for them.
+        static thread_local _Entropy_cache _Cache;
+        return _Cache._Read(_Buf, _Count);
+    }
+
+    random_stream::random_stream() noexcept : _Mykey{0} {}
+
+    random_stream::~random_stream() noexcept {
+        ::SecureZeroMemory(_Mykey, sizeof(_Mykey)); // the key would reveal the random passes
+    }
+
+    bool random_stream::seed() noexcept {
+        return fill_with_random_bytes(reinterpret_cast<byte_t*>(_Mykey), sizeof(_Mykey));
+    }
+
+    void random_stream::generate(const uint64_t _Nonce, const uint64_t _Offset, byte_t* const _Buf,
+        const size_t _Size) const noexcept {
+        // Note: The whole blocks are generated directly into the buffer by the bound kernel. The offset
+        //       may point into the middle of a block, in which case the leading bytes of that block
+        //       are skipped. A partial block at either end is generated separately.
+        byte_t _Partial[chacha20_block_size];
+        uint64_t _Counter  = _Offset / chacha20_block_size;
+        const size_t _Skip = static_cast<size_t>(_Offset % chacha20_block_size);
+        size_t _Off        = 0;
+        if (_Skip != 0) {
+            ::mjx::generate_chacha20_blocks(_Mykey, _Nonce, _Counter++, _Partial, 1);
+            _Off = (::std::min)(chacha20_block_size - _Skip, _Size);
+            ::memcpy(_Buf, _Partial + _Skip, _Off);
+        }
+
+        const size_t _Whole = (_Size - _Off) / chacha20_block_size;
+        ::mjx::generate_chacha20_blocks(_Mykey, _Nonce, _Counter, _Buf + _Off, _Whole);
+        _Counter += _Whole;
+        _Off     += _Whole * chacha20_block_size;
+        if (_Off < _Size) {
+            ::mjx::generate_chacha20_blocks(_Mykey, _Nonce, _Counter, _Partial, 1);
+            ::memcpy(_Buf + _Off, _Partial, _Size - _Off);
+        }
+
+        ::SecureZeroMemory(_Partial, sizeof(_Partial));
+    }
 } // namespace mjx
\ No newline at end of file
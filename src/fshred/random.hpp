@@ -6,11 +6,82 @@
 #pragma once
 #ifndef _FSHRED_RANDOM_HPP_
 #define _FSHRED_RANDOM_HPP_
+#include <condition_variable>
 #include <cstddef>
+#include <cstdint>
+#include <mjmem/smart_pointer.hpp>
 #include <mjstr/char_traits.hpp>
+#include <mutex>
 
 namespace mjx {
     bool fill_with_random_bytes(byte_t* const _Buf, const size_t _Count) noexcept;
+
+    class _Entropy_cache { // serves random bytes from large blocks of OS entropy
+    public:
+        _Entropy_cache() noexcept;
+        ~_Entropy_cache() noexcept;
+
+        _Entropy_cache(const _Entropy_cache&)            = delete;
+        _Entropy_cache& operator=(const _Entropy_cache&) = delete;
+
+        // copies the next unused random bytes to the buffer
+        bool _Read(byte_t* const _Buf, const size_t _Count) noexcept;
+
+        static constexpr size_t _Block_size = 1048576; // 1 MiB
+
+    private:
+        struct _Refill_state { // shared with the refill thread, which may outlive the cache
+            ::std::mutex _Mtx;
+            ::std::condition_variable _State_changed; // signaled on a request, a finished refill or a stop
+            byte_t* _Block; // block to refill, set by each request
+            bool _Refilling; // a refill has been requested and has not finished yet
+            bool _Stopping;
+            bool _Result; // false once a refill has failed, until it is reported by _Wait()
+        };
+
+        // allocates both blocks, fills the first one and starts refilling the second one
+        bool _Allocate() noexcept;
+
+        // refills the requested blocks until the cache is destroyed
+        static void _Run(const smart_ptr<_Refill_state> _State) noexcept;
+
+        // starts refilling the spare block in the background
+        void _Start_refill() noexcept;
+
+        // waits for the spare block to be refilled
+        bool _Wait() noexcept;
+
+        // replaces the exhausted block with the refilled one
+        bool _Swap() noexcept;
+
+        unique_smart_array<byte_t> _Myblock; // block being served
+        unique_smart_array<byte_t> _Myspare; // block being refilled
+        size_t _Mypos; // number of bytes of the current block already served
+        smart_ptr<_Refill_state> _Myrefill; // null until the refill thread is started
+        bool _Myresult; // false once a synchronous refill has failed, until it is reported by _Wait()
+    };
+
+    // fills the buffer with random bytes taken from the entropy cache of the calling thread
+    bool fill_with_cached_random_bytes(byte_t* const _Buf, const size_t _Count) noexcept;
+
+    class random_stream { // ChaCha20 keystream, the bytes at any offset can be generated again
+    public:
+        random_stream() noexcept;
+        ~random_stream() noexcept;
+
+        random_stream(const random_stream&)            = delete;
+        random_stream& operator=(const random_stream&) = delete;
+
+        // draws a new key from the system generator
+        bool seed() noexcept;
+
+        // generates the bytes at the offset, streams with different nonces are independent
+        void generate(const uint64_t _Nonce, const uint64_t _Offset, byte_t* const _Buf,
+            const size_t _Size) const noexcept;
+
+    private:
+        uint32_t _Mykey[8];
+    };
 } // namespace mjx
 
 #endif // _FSHRED_RANDOM_HPP_
\ No newline at end of file
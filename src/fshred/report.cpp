@@ -0,0 +1,99 @@
+// report.cpp
+
+// Copyright (c) Mateusz Jandura. All rights reserved.
+// SPDX-License-Identifier: Apache-2.0
+
+#include <algorithm>
+#include <cstdarg>
+#include <cstdio>
+#include <fshred/report.hpp>
+#include <mjfs/file.hpp>
+#include <mjfs/file_stream.hpp>
+#include <mjfs/status.hpp>
+
+namespace mjx {
+    inline bool _Open_for_writing(const path& _Target, file& _File) {
+        if (!::mjx::exists(_Target)) {
+            if (!::mjx::create_file(_Target, &_File)) {
+                return false;
+            }
+        } else if (!_File.open(_Target, file_access::write)) {
+            return false;
+        }
+
+        return _File.resize(0);
+    }
+
+    shred_report::shred_report() noexcept
+        : _Mymtx(), _Mytext(), _Myfile(), _Mystream(), _Myfailed(false) {}
+
+    shred_report::~shred_report() noexcept {}
+
+    void shred_report::_Write(const char* const _Data, const size_t _Size) {
+        if (!_Mystream.is_open()) { // not opened, keep the text until it is saved
+            _Mytext.append(_Data, _Size);
+            return;
+        }
+
+        if (!_Mystream.write(reinterpret_cast<const byte_t*>(_Data), _Size) || !_Mystream.flush()) {
+            _Myfailed = true;
+        }
+    }
+
+    void shred_report::print(const char* const _Fmt, ...) noexcept {
+        char _Line[512]; // long lines are truncated
+        va_list _Args;
+        va_start(_Args, _Fmt);
+        const int _Length = ::vsnprintf(_Line, sizeof(_Line), _Fmt, _Args);
+        va_end(_Args);
+        if (_Length < 0) { // invalid format, do nothing
+            return;
+        }
+
+        try {
+            ::std::lock_guard<::std::mutex> _Guard(_Mymtx);
+            _Write(_Line, (::std::min)(static_cast<size_t>(_Length), sizeof(_Line) - 1));
+            _Write("\n", 1);
+        } catch (...) {
+            // the report is informational, losing a line is not an error
+        }
+    }
+
+    void shred_report::append(const utf8_string& _Text) noexcept {
+        try {
+            ::std::lock_guard<::std::mutex> _Guard(_Mymtx);
+            _Write(_Text.data(), _Text.size());
+        } catch (...) {
+            // the report is informational, losing a text is not an error
+        }
+    }
+
+    bool shred_report::save(const path& _Target) const {
+        file _File;
+        if (!::mjx::_Open_for_writing(_Target, _File)) {
+            return false;
+        }
+
+        ::std::lock_guard<::std::mutex> _Guard(_Mymtx);
+        file_stream _Stream(_File);
+        return _Stream.write(reinterpret_cast<const byte_t*>(_Mytext.data()), _Mytext.size())
+            && _Stream.flush();
+    }
+
+    bool shred_report::open(const path& _Target) {
+        ::std::lock_guard<::std::mutex> _Guard(_Mymtx);
+        if (!::mjx::_Open_for_writing(_Target, _Myfile)) {
+            return false;
+        }
+
+        _Mystream.bind_file(_Myfile);
+        _Write(_Mytext.data(), _Mytext.size()); // the text appended so far comes first
+        _Mytext.clear();
+        return !_Myfailed;
+    }
+
+    bool shred_report::failed() const noexcept {
+        ::std::lock_guard<::std::mutex> _Guard(_Mymtx);
+        return _Myfailed;
+    }
+} // namespace mjx
\ No newline at end of file
@@ -0,0 +1,55 @@
+// report.hpp
+
+// Copyright (c) Mateusz Jandura. All rights reserved.
+// SPDX-License-Identifier: Apache-2.0
+
+#pragma once
+#ifndef _FSHRED_REPORT_HPP_
+#define _FSHRED_REPORT_HPP_
+#include <cstddef>
+#include <mjfs/file.hpp>
+#include <mjfs/file_stream.hpp>
+#include <mjfs/path.hpp>
+#include <mjstr/string.hpp>
+#include <mutex>
+
+namespace mjx {
+    class shred_report { // thread-safe plain-text report of a shredding batch
+    public:
+        shred_report() noexcept;
+        ~shred_report() noexcept;
+
+        shred_report(const shred_report&)            = delete;
+        shred_report& operator=(const shred_report&) = delete;
+
+        // appends a printf-style formatted line
+        void print(const char* const _Fmt, ...) noexcept;
+
+        // appends the text as a whole, so that it is not interleaved with lines of other threads
+        void append(const utf8_string& _Text) noexcept;
+
+        // writes the report to the file, replaces its previous contents
+        bool save(const path& _Target) const;
+
+        // opens the file, replaces its previous contents and writes every later text to it at once
+        bool open(const path& _Target);
+
+        // checks whether a text could not be written to the opened file
+        bool failed() const noexcept;
+
+    private:
+        // writes the text to the opened file or keeps it in memory, must be called under the lock
+        void _Write(const char* const _Data, const size_t _Size);
+
+        // Note: An opened report is written and flushed as it grows, so nothing is lost if the process
+        //       ends unexpectedly and the memory does not grow with the batch. Otherwise the text
+        //       is kept in memory until it is saved.
+        mutable ::std::mutex _Mymtx;
+        utf8_string _Mytext;
+        file _Myfile;
+        file_stream _Mystream;
+        bool _Myfailed;
+    };
+} // namespace mjx
+
+#endif // _FSHRED_REPORT_HPP_
\ No newline at end of file
@@ -0,0 +1,460 @@
+// scheduler.cpp
+
+// Copyright (c) Mateusz Jandura. All rights reserved.
+// SPDX-License-Identifier: Apache-2.0
+
+#include <algorithm>
+#include <bitset>
+#include <fshred/certificate.hpp>
+#include <fshred/device.hpp>
+#include <fshred/scheduler.hpp>
+#include <fshred/tinywin.hpp>
+#include <mjstr/conversion.hpp>
+#include <utility>
+#include <winioctl.h> // include after <Windows.h>
+
+namespace mjx {
+    // Note: Rotational devices lose most of their throughput when several files are written at once,
+    //       because every switch between files costs a seek. Solid-state devices need a few requests
+    //       in flight to reach their full throughput. The controller adjusts the concurrency within
+    //       the limits while shredding.
+    inline constexpr device_limits _Rotational_device_limits  = {1, 1};
+    inline constexpr device_limits _Solid_state_device_limits = {4, 16};
+    inline constexpr device_limits _Unknown_device_limits     = {2, 8};
+
+    inline bool _Query_seek_penalty(const file& _File, bool& _Penalty) noexcept {
+        _Volume_handle _Volume(_File, 0);
+        if (!_Volume._Valid()) {
+            return false;
+        }
+
+        STORAGE_PROPERTY_QUERY _Query          = {StorageDeviceSeekPenaltyProperty, PropertyStandardQuery};
+        DEVICE_SEEK_PENALTY_DESCRIPTOR _Result = {0};
+        DWORD _Bytes                           = 0;
+        if (!::DeviceIoControl(_Volume._Get(), IOCTL_STORAGE_QUERY_PROPERTY, &_Query, sizeof(_Query),
+            &_Result, sizeof(_Result), &_Bytes, nullptr) || _Bytes < sizeof(_Result)) {
+            return false;
+        }
+
+        _Penalty = _Result.IncursSeekPenalty != 0;
+        return true;
+    }
+
+    device_limits query_device_limits(const file& _File) noexcept {
+        bool _Penalty;
+        if (!_Query_seek_penalty(_File, _Penalty)) {
+            return _Unknown_device_limits;
+        }
+
+        return _Penalty ? _Rotational_device_limits : _Solid_state_device_limits;
+    }
+
+    _Backlog::_Backlog(const size_t _Limit) noexcept
+        : _Mymtx(), _Myhas_room(), _Mypending(0), _Mylimit((::std::max)(_Limit, size_t{1})) {}
+
+    _Backlog::~_Backlog() noexcept {}
+
+    void _Backlog::_Limit(const size_t _New_limit) noexcept {
+        {
+            ::std::lock_guard<::std::mutex> _Guard(_Mymtx);
+            _Mylimit = (::std::max)(_New_limit, size_t{1});
+        }
+
+        _Myhas_room.notify_all();
+    }
+
+    void _Backlog::_Acquire() noexcept {
+        ::std::unique_lock<::std::mutex> _Lock(_Mymtx);
+        _Myhas_room.wait(_Lock, [this] { return _Mypending < _Mylimit; });
+        ++_Mypending;
+    }
+
+    void _Backlog::_Release() noexcept {
+        {
+            ::std::lock_guard<::std::mutex> _Guard(_Mymtx);
+            --_Mypending;
+        }
+
+        _Myhas_room.notify_one();
+    }
+
+    _Device_queue::_Device_queue(const device_limits& _Limits, io_throttle& _Global_throttle,
+        _Backlog& _Pending, shred_report* const _Report, shred_report* const _Certificates,
+        buffer_pool* const _Buffers, const cancellation_token* const _Cancel)
+        : _Mylimits(_Limits), _Mythrottle(&_Global_throttle),
+        _Mycontroller(_Limits.concurrency, 1, _Limits.max_concurrency), _Mymtx(), _Myhas_jobs(),
+        _Mybacklog(&_Pending), _Myjobs(), _Mygroup(), _Myworkers(), _Myactive(0), _Mydraining(false),
+        _Myresult(shred_status::success), _Myreport(_Report), _Mycerts(_Certificates), _Mybuffers(_Buffers),
+        _Mycancel(_Cancel) {
+        _Mycontroller.attach_listener(this);
+        try {
+            _Myworkers.reserve(_Mylimits.max_concurrency);
+            for (size_t _Idx = 0; _Idx < _Mylimits.max_concurrency; ++_Idx) {
+                _Myworkers.emplace_back(&_Device_queue::_Work, this);
+            }
+        } catch (...) {
+            _Drain(); // join already started workers
+            throw;
+        }
+    }
+
+    _Device_queue::~_Device_queue() noexcept {
+        _Drain();
+    }
+
+    void _Device_queue::_Report(const shred_status _Status) noexcept {
+        if (_Status != shred_status::success) {
+            ::std::lock_guard<::std::mutex> _Guard(_Mymtx);
+            if (_Myresult == shred_status::success) { // remember the first failure
+                _Myresult = _Status;
+            }
+        }
+    }
+
+    void _Device_queue::_Finish(shred_job& _Job, const bool _Overwritten) noexcept {
+        shred_status _Status;
+        try {
+            _Status = finish_shred_job(_Job, _Overwritten);
+        } catch (...) {
+            _Status = shred_status::cannot_shred_file;
+        }
+
+        _Record(_Job, _Status);
+    }
+
+    void _Device_queue::_Record(shred_job& _Job, const shred_status _Status) noexcept {
+        _Report(_Status);
+        if (_Mycerts) {
+            ::mjx::print_certificate(*_Mycerts, _Job, _Status);
+        }
+
+        if (!_Myreport) { // no report requested
+            return;
+        }
+
+        try {
+            const utf8_string _Name  = ::mjx::to_utf8_string(_Job.target.native());
+            const char* const _Path = _Job.stats.zeroing_offloaded
+                ? "zeroed by the file system" : shred_engine_name(_Job.stats.engine);
+            _Myreport->print("file %s: %s, %llu bytes, fills %.3f s, writes %.3f s, barriers %.3f s "
+                "(%s, %s, %s)", _Name.c_str(), shred_status_name(_Status),
+                static_cast<unsigned long long>(_Job.stats.bytes_written),
+                ::std::chrono::duration<double>(_Job.stats.fill_time).count(),
+                ::std::chrono::duration<double>(_Job.stats.write_time).count(),
+                ::std::chrono::duration<double>(_Job.stats.barrier_time).count(),
+                shred_method_name(_Job.settings.method), _Path,
+                durability_policy_name(_Job.settings.durability));
+            if (_Job.settings.verification != verify_mode::none) {
+                const double _Coverage = _Job.stats.bytes_verifiable != 0
+                    ? 100.0 * static_cast<double>(_Job.stats.bytes_verified)
+                        / static_cast<double>(_Job.stats.bytes_verifiable)
+                    : 0.0;
+                _Myreport->print("file %s: %s, %u passes, %u not verified, %llu bytes, "
+                    "%.1f%% coverage, %llu mismatched blocks, %.3f s", _Name.c_str(),
+                    verify_mode_name(_Job.settings.verification), _Job.stats.passes_verified,
+                    _Job.stats.passes_unverified, static_cast<unsigned long long>(_Job.stats.bytes_verified),
+                    _Coverage, static_cast<unsigned long long>(_Job.stats.mismatches),
+                    ::std::chrono::duration<double>(_Job.stats.verify_time).count());
+            }
+
+            if (_Job.stats.cancelled) {
+                _Myreport->print("file %s: stopped at pass %u, offset %llu of %llu bytes", _Name.c_str(),
+                    static_cast<unsigned int>(_Job.stats.stopped_pass),
+                    static_cast<unsigned long long>(_Job.stats.stopped_offset),
+                    static_cast<unsigned long long>(_Job.stats.file_size));
+            }
+
+            if (_Job.stats.resumed) {
+                _Myreport->print("file %s: resumed at pass %u, offset %llu", _Name.c_str(),
+                    static_cast<unsigned int>(_Job.stats.resumed_pass),
+                    static_cast<unsigned long long>(_Job.stats.resumed_offset));
+            }
+
+            if (_Job.settings.hash_passes) {
+                _Myreport->print("file %s: %zu passes hashed, hashing %.3f s", _Name.c_str(),
+                    ::std::bitset<8>(_Job.stats.hashed_passes).count(),
+                    ::std::chrono::duration<double>(_Job.stats.hash_time).count());
+            }
+        } catch (...) {
+            // the report is informational, losing a line is not an error
+        }
+    }
+
+    void _Device_queue::_Flush_group(::std::vector<shred_job>& _Group) noexcept {
+        // Note: Flushing the volume makes all files durable with a single barrier, but it requires
+        //       administrator rights. Without them, each file is flushed separately, which still
+        //       saves a barrier per pass. The volume barrier time is split evenly between the files.
+        using _Clock = ::std::chrono::steady_clock;
+        _Clock::time_point _Start = _Clock::now();
+        if (::mjx::flush_volume(_Group.front().handle)) {
+            const _Clock::duration _Share =
+                (_Clock::now() - _Start) / static_cast<_Clock::rep>(_Group.size());
+            for (shred_job& _Job : _Group) {
+                _Job.stats.barrier_time += _Share;
+                _Finish(_Job, true);
+            }
+        } else {
+            bool _Flushed;
+            for (shred_job& _Job : _Group) {
+                _Start   = _Clock::now();
+                _Flushed = ::mjx::flush_file_data(_Job.handle);
+                _Job.stats.barrier_time += _Clock::now() - _Start;
+                _Finish(_Job, _Flushed);
+            }
+        }
+
+        _Group.clear();
+    }
+
+    void _Device_queue::_Work() noexcept {
+        const shred_context _Context = {shred_settings{}, &_Mythrottle, &_Mycontroller, nullptr, _Mybuffers,
+            nullptr, 0, _Mycancel, nullptr};
+        shred_job _Job;
+        ::std::vector<shred_job> _Group;
+        size_t _Group_size;
+        shred_status _Status;
+        bool _Overwritten;
+        for (;;) {
+            {
+                ::std::unique_lock<::std::mutex> _Lock(_Mymtx);
+                for (;;) {
+                    if (_Myjobs.empty()) {
+                        if (_Mydraining) { // drained, no more jobs will come
+                            return;
+                        }
+
+                        _Myhas_jobs.wait(_Lock);
+                    } else if (_Myactive >= _Mycontroller.limit()) { // wait for a free slot or a grown limit
+                        _Myhas_jobs.wait(_Lock);
+                    } else {
+                        break;
+                    }
+                }
+
+                _Job = ::std::move(_Myjobs.front());
+                _Myjobs.pop_front();
+                ++_Myactive;
+            }
+
+            _Mybacklog->_Release();
+            if (_Mycancel && _Mycancel->requested()) { // stopped, the waiting files are not opened anymore
+                _Status = shred_status::cancelled;
+                if (_Job.journal) { // the progress is kept, only the result is recorded
+                    _Job.journal->finish(
+                        _Job.journal_slot, _Status, file_metadata{file_id{0, 0}, 0, 0, 0, 0});
+                }
+
+                _Record(_Job, _Status); // the file still gets its report line and certificate
+            } else {
+                _Status = ::mjx::open_shred_job(_Job);
+                if (_Status != shred_status::success) { // could not open the file, nothing to overwrite
+                    _Record(_Job, _Status);
+                }
+            }
+
+            if (_Status == shred_status::success) {
+                _Overwritten = ::mjx::overwrite_job_data(_Job, _Context);
+                if (_Overwritten && _Job.settings.durability == durability_policy::flush_per_group) {
+                    _Group_size = (::std::max)(_Job.settings.barrier_group_size, size_t{1});
+                    try {
+                        ::std::lock_guard<::std::mutex> _Guard(_Mymtx);
+                        _Mygroup.push_back(::std::move(_Job));
+                        if (_Mygroup.size() >= _Group_size) { // the group is complete, flush it
+                            _Group.swap(_Mygroup);
+                        }
+                    } catch (...) { // could not park the job, flush it alone
+                        _Finish(_Job, ::mjx::flush_file_data(_Job.handle));
+                    }
+
+                    if (!_Group.empty()) {
+                        _Flush_group(_Group);
+                    }
+                } else {
+                    _Finish(_Job, _Overwritten);
+                }
+            }
+
+            {
+                ::std::lock_guard<::std::mutex> _Guard(_Mymtx);
+                --_Myactive;
+            }
+
+            _Myhas_jobs.notify_one(); // let a waiting worker take the freed slot
+        }
+    }
+
+    void _Device_queue::_Push(shred_job&& _Job) {
+        {
+            ::std::lock_guard<::std::mutex> _Guard(_Mymtx);
+            _Myjobs.push_back(::std::move(_Job));
+        }
+
+        _Myhas_jobs.notify_one();
+    }
+
+    void _Device_queue::_Drain() noexcept {
+        {
+            ::std::lock_guard<::std::mutex> _Guard(_Mymtx);
+            _Mydraining = true;
+        }
+
+        _Myhas_jobs.notify_all();
+        for (::std::thread& _Worker : _Myworkers) {
+            if (_Worker.joinable()) {
+                _Worker.join();
+            }
+        }
+
+        _Myworkers.clear();
+        if (!_Mygroup.empty()) { // flush the last incomplete group
+            _Flush_group(_Mygroup);
+        }
+    }
+
+    shred_status _Device_queue::_Result() const noexcept {
+        ::std::lock_guard<::std::mutex> _Guard(_Mymtx);
+        return _Myresult;
+    }
+
+    io_throttle& _Device_queue::_Throttle() noexcept {
+        return _Mythrottle;
+    }
+
+    const concurrency_controller& _Device_queue::_Controller() const noexcept {
+        return _Mycontroller;
+    }
+
+    void _Device_queue::limit_grown() noexcept {
+        {
+            ::std::lock_guard<::std::mutex> _Guard(_Mymtx); // a worker may be about to wait
+        }
+
+        _Myhas_jobs.notify_all();
+    }
+
+    shred_scheduler::shred_scheduler() noexcept
+        : _Myoverride{0, 0}, _Mybacklog(_Default_backlog), _Mythrottle(), _Mydevice_io_limits{0, 0}, _Mymtx(),
+        _Myqueues(),
+        _Myhistory(), _Myreport(nullptr), _Mycerts(nullptr), _Mybuffers(nullptr), _Mycancel(nullptr) {}
+
+    shred_scheduler::~shred_scheduler() noexcept {
+        wait();
+    }
+
+    void shred_scheduler::override_limits(const device_limits& _Limits) noexcept {
+        _Myoverride = _Limits;
+    }
+
+    void shred_scheduler::backlog_limit(const size_t _Limit) noexcept {
+        _Mybacklog._Limit(_Limit != 0 ? _Limit : _Default_backlog);
+    }
+
+    void shred_scheduler::attach_report(shred_report* const _Report) noexcept {
+        _Myreport = _Report;
+    }
+
+    void shred_scheduler::attach_certificates(shred_report* const _Certificates) noexcept {
+        _Mycerts = _Certificates;
+    }
+
+    void shred_scheduler::attach_buffers(buffer_pool* const _Buffers) noexcept {
+        _Mybuffers = _Buffers;
+    }
+
+    void shred_scheduler::attach_cancellation(const cancellation_token* const _Cancel) noexcept {
+        _Mycancel = _Cancel;
+    }
+
+    io_throttle& shred_scheduler::throttle() noexcept {
+        return _Mythrottle;
+    }
+
+    void shred_scheduler::device_io_limits(const io_limits& _New_limits) noexcept {
+        ::std::lock_guard<::std::mutex> _Guard(_Mymtx);
+        _Mydevice_io_limits = _New_limits;
+        for (auto& _Pair : _Myqueues) {
+            if (_Pair.second) {
+                _Pair.second->_Throttle().limits(_New_limits);
+            }
+        }
+    }
+
+    bool shred_scheduler::device_io_limits(const uint32_t _Device, const io_limits& _New_limits) noexcept {
+        ::std::lock_guard<::std::mutex> _Guard(_Mymtx);
+        const auto _Iter = _Myqueues.find(_Device);
+        if (_Iter == _Myqueues.end() || !_Iter->second) { // the device is not used
+            return false;
+        }
+
+        _Iter->second->_Throttle().limits(_New_limits);
+        return true;
+    }
+
+    void shred_scheduler::submit(const uint32_t _Device, shred_job&& _Job) {
+        _Mybacklog._Acquire(); // wait for any device to take a file, not for this one
+        try {
+            ::std::lock_guard<::std::mutex> _Guard(_Mymtx);
+            unique_smart_ptr<_Device_queue>& _Slot = _Myqueues[_Device];
+            if (!_Slot) { // first job for this device, tune the queue for it
+                const file _Probe(_Job.target, file_access::none, file_share::all);
+                device_limits _Limits = query_device_limits(_Probe);
+                if (_Myoverride.concurrency != 0) {
+                    _Limits.concurrency = _Myoverride.concurrency;
+                }
+
+                if (_Myoverride.max_concurrency != 0) {
+                    _Limits.max_concurrency = _Myoverride.max_concurrency;
+                }
+
+                _Slot = ::mjx::make_unique_smart_ptr<_Device_queue>(
+                    _Limits, _Mythrottle, _Mybacklog, _Myreport, _Mycerts, _Mybuffers, _Mycancel);
+                _Slot->_Throttle().limits(_Mydevice_io_limits);
+            }
+
+            _Slot->_Push(::std::move(_Job));
+        } catch (...) {
+            _Mybacklog._Release();
+            throw;
+        }
+    }
+
+    ::std::vector<device_stats> shred_scheduler::stats() {
+        ::std::lock_guard<::std::mutex> _Guard(_Mymtx);
+        ::std::vector<device_stats> _Result = _Myhistory;
+        for (const auto& _Pair : _Myqueues) {
+            if (_Pair.second) {
+                _Result.push_back({_Pair.first, _Pair.second->_Controller().stats()});
+            }
+        }
+
+        return _Result;
+    }
+
+    shred_status shred_scheduler::wait() noexcept {
+        shred_status _Result = shred_status::success;
+        for (auto& _Pair : _Myqueues) {
+            if (!_Pair.second) { // the queue could not be created
+                continue;
+            }
+
+            _Pair.second->_Drain(); // the remaining devices keep working in the meantime
+            if (_Result == shred_status::success) {
+                _Result = _Pair.second->_Result();
+            }
+        }
+
+        ::std::lock_guard<::std::mutex> _Guard(_Mymtx);
+        for (const auto& _Pair : _Myqueues) {
+            if (_Pair.second) {
+                try {
+                    _Myhistory.push_back({_Pair.first, _Pair.second->_Controller().stats()});
+                } catch (...) {
+                    // stats are informational, losing them is not an error
+                }
+            }
+        }
+
+        _Myqueues.clear();
+        return _Result;
+    }
+} // namespace mjx
\ No newline at end of file
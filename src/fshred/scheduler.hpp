@@ -0,0 +1,195 @@
+// scheduler.hpp
+
+// Copyright (c) Mateusz Jandura. All rights reserved.
+// SPDX-License-Identifier: Apache-2.0
+
+#pragma once
+#ifndef _FSHRED_SCHEDULER_HPP_
+#define _FSHRED_SCHEDULER_HPP_
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <fshred/buffer.hpp>
+#include <fshred/cancel.hpp>
+#include <fshred/controller.hpp>
+#include <fshred/job.hpp>
+#include <fshred/report.hpp>
+#include <fshred/throttle.hpp>
+#include <mjfs/file.hpp>
+#include <mjmem/smart_pointer.hpp>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+namespace mjx {
+    struct device_limits {
+        size_t concurrency; // initial number of files shredded at once
+        size_t max_concurrency; // number of files shredded at once the controller may grow to
+    };
+
+    struct device_stats {
+        uint32_t device;
+        concurrency_stats concurrency;
+    };
+
+    // suggests limits for the device that stores the file
+    device_limits query_device_limits(const file& _File) noexcept;
+
+    class _Backlog { // number of files submitted to any device and not taken by a worker yet
+    public:
+        explicit _Backlog(const size_t _Limit) noexcept;
+        ~_Backlog() noexcept;
+
+        _Backlog(const _Backlog&)            = delete;
+        _Backlog& operator=(const _Backlog&) = delete;
+
+        // changes the number of files that may wait at once
+        void _Limit(const size_t _New_limit) noexcept;
+
+        // takes a place for a new file, blocks while the backlog is full
+        void _Acquire() noexcept;
+
+        // frees the place of a file taken by a worker
+        void _Release() noexcept;
+
+    private:
+        ::std::mutex _Mymtx;
+        ::std::condition_variable _Myhas_room;
+        size_t _Mypending;
+        size_t _Mylimit;
+    };
+
+    class _Device_queue : public concurrency_listener { // jobs destined for a single device
+    public:
+        _Device_queue(const device_limits& _Limits, io_throttle& _Global_throttle, _Backlog& _Pending,
+            shred_report* const _Report, shred_report* const _Certificates, buffer_pool* const _Buffers,
+            const cancellation_token* const _Cancel);
+        ~_Device_queue() noexcept override;
+
+        _Device_queue(const _Device_queue&)            = delete;
+        _Device_queue& operator=(const _Device_queue&) = delete;
+
+        // enqueues the job, never blocks, the backlog place must already be taken
+        void _Push(shred_job&& _Job);
+
+        // stops accepting new jobs and waits for the queued ones
+        void _Drain() noexcept;
+
+        // returns the first failure reported by the workers
+        shred_status _Result() const noexcept;
+
+        // returns the throttle shared by all workers of this device
+        io_throttle& _Throttle() noexcept;
+
+        // returns the controller of the number of files shredded at once
+        const concurrency_controller& _Controller() const noexcept;
+
+        // wakes the workers waiting for the limit to grow
+        void limit_grown() noexcept override;
+
+    private:
+        // executes the queued jobs until the queue is drained
+        void _Work() noexcept;
+
+        // records the job result
+        void _Report(const shred_status _Status) noexcept;
+
+        // records the job result, writes its report lines and certificate
+        void _Record(shred_job& _Job, const shred_status _Status) noexcept;
+
+        // finishes the overwritten job and records its result
+        void _Finish(shred_job& _Job, const bool _Overwritten) noexcept;
+
+        // makes the overwritten files durable with a single barrier and finishes them
+        void _Flush_group(::std::vector<shred_job>& _Group) noexcept;
+
+        // Note: There is a worker for the maximum concurrency, but only as many of them as the controller
+        //       allows run a job at once. The rest wait until the controller signals that the limit grew.
+        device_limits _Mylimits;
+        io_throttle _Mythrottle;
+        concurrency_controller _Mycontroller;
+        mutable ::std::mutex _Mymtx;
+        ::std::condition_variable _Myhas_jobs; // signaled on a push, a finished job, a grown limit or drain
+        _Backlog* _Mybacklog; // shared by all devices
+        ::std::deque<shred_job> _Myjobs; // not opened yet, so they hold no handle
+        ::std::vector<shred_job> _Mygroup; // overwritten jobs waiting for a common barrier
+        ::std::vector<::std::thread> _Myworkers;
+        size_t _Myactive; // number of jobs being executed
+        bool _Mydraining;
+        shred_status _Myresult;
+        shred_report* _Myreport; // receives a line per file, may be null
+        shred_report* _Mycerts; // receives a certificate per file, may be null
+        buffer_pool* _Mybuffers; // shared by all devices, may be null
+        const cancellation_token* _Mycancel; // stops the running files, may be null
+    };
+
+    class shred_scheduler { // runs jobs concurrently, grouped by the device that stores them
+    public:
+        shred_scheduler() noexcept;
+        ~shred_scheduler() noexcept;
+
+        shred_scheduler(const shred_scheduler&)            = delete;
+        shred_scheduler& operator=(const shred_scheduler&) = delete;
+
+        // overrides the detected limits, zero members are still detected
+        void override_limits(const device_limits& _Limits) noexcept;
+
+        // changes the number of files that may wait for a worker, in total, 0 restores the default
+        void backlog_limit(const size_t _Limit) noexcept;
+
+        // assigns the report that receives a line per file, must outlive the scheduler
+        void attach_report(shred_report* const _Report) noexcept;
+
+        // assigns the report that receives a certificate per file, must outlive the scheduler
+        void attach_certificates(shred_report* const _Certificates) noexcept;
+
+        // assigns the pool that provides the write buffers, must outlive the scheduler
+        void attach_buffers(buffer_pool* const _Buffers) noexcept;
+
+        // assigns the token that stops the running and queued files, must outlive the scheduler
+        void attach_cancellation(const cancellation_token* const _Cancel) noexcept;
+
+        // returns the throttle shared by all devices
+        io_throttle& throttle() noexcept;
+
+        // changes the write limits of every device, including the ones that are not used yet
+        void device_io_limits(const io_limits& _New_limits) noexcept;
+
+        // changes the write limits of the specified device
+        bool device_io_limits(const uint32_t _Device, const io_limits& _New_limits) noexcept;
+
+        // enqueues the job, blocks only while the backlog of all devices is full
+        void submit(const uint32_t _Device, shred_job&& _Job);
+
+        // returns the controller decisions of all devices used so far
+        ::std::vector<device_stats> stats();
+
+        // waits for all submitted jobs, returns the first failure
+        shred_status wait() noexcept;
+
+    private:
+        // Note: Each device has its own queue, which never blocks the producer, so a slow device does not
+        //       hold back the others. Only the number of files waiting in all queues is bounded, which
+        //       keeps the memory bounded even if millions of files are listed. It is large enough that
+        //       the producer is far ahead of the devices whenever it waits for it.
+        static constexpr size_t _Default_backlog = 64 * 1024;
+
+        // Note: Jobs are submitted and awaited by a single thread, but the limits may be changed
+        //       by any thread, so the queue map is only modified while holding the lock.
+        device_limits _Myoverride;
+        _Backlog _Mybacklog;
+        io_throttle _Mythrottle;
+        io_limits _Mydevice_io_limits;
+        ::std::mutex _Mymtx;
+        ::std::unordered_map<uint32_t, unique_smart_ptr<_Device_queue>> _Myqueues;
+        ::std::vector<device_stats> _Myhistory; // stats of the already drained devices
+        shred_report* _Myreport;
+        shred_report* _Mycerts;
+        buffer_pool* _Mybuffers;
+        const cancellation_token* _Mycancel;
+    };
+} // namespace mjx
+
+#endif // _FSHRED_SCHEDULER_HPP_
\ No newline at end of file
@@ -3,9 +3,14 @@
 // Copyright (c) Mateusz Jandura. All rights reserved.
 // SPDX-License-Identifier: Apache-2.0
 
+#include <chrono>
 #include <cstring>
+#include <fshred/device.hpp>
+#include <fshred/fill.hpp>
+#include <fshred/kernels.hpp>
 #include <fshred/shredder.hpp>
 #include <fshred/random.hpp>
+#include <fshred/verify.hpp>
 #include <utility>
 
 namespace mjx {
@@ -19,32 +24,40 @@ namespace mjx {
 
     bool _Dod_5220_22_m_e::_Run_pass_1(byte_t* const _Buf, const size_t _Size) noexcept {
         // "pass 1: Overwrite the data with a defined fixed value"
-        ::memset(_Buf, static_cast<int>(_Myval), _Size);
+        ::mjx::fill_constant(_Buf, _Size, _Myval);
         return true;
     }
 
     bool _Dod_5220_22_m_e::_Run_pass_2(byte_t* const _Buf, const size_t _Size) noexcept {
         // "pass 2: Overwrite the data with the complement value of the first run"
-        ::memset(_Buf, static_cast<int>(~_Myval), _Size);
+        ::mjx::fill_constant(_Buf, _Size, static_cast<byte_t>(~_Myval));
         return true;
     }
 
     bool _Dod_5220_22_m_e::_Run_pass_3(byte_t* const _Buf, const size_t _Size) noexcept {
         // "pass 3: Overwrite the data with pseudo random values"
-        return fill_with_random_bytes(_Buf, _Size);
+        return ::mjx::fill_random(_Buf, _Size);
     }
 
     bool _Dod_5220_22_m_e::_Reset() noexcept {
         return _Get_fixed_value(_Myval); // generates a new fixed value
     }
 
+    byte_t _Dod_5220_22_m_e::_Fixed_value() const noexcept {
+        return _Myval;
+    }
+
+    void _Dod_5220_22_m_e::_Restore(const byte_t _Val) noexcept {
+        _Myval = _Val;
+    }
+
     _Dod_5220_22_m_ece::_Dod_5220_22_m_ece() noexcept : _Myeng() {}
 
     _Dod_5220_22_m_ece::~_Dod_5220_22_m_ece() noexcept {}
 
     bool _Dod_5220_22_m_ece::_Run_pass_1(byte_t* const _Buf, const size_t _Size) noexcept {
         // "pass 1-3: overwrite the data with DoD 5220.22-M (E) Standard"
-        return _Myeng._Reset() && _Myeng._Run_pass_1(_Buf, _Size);
+        return _Myeng._Run_pass_1(_Buf, _Size);
     }
 
     bool _Dod_5220_22_m_ece::_Run_pass_2(byte_t* const _Buf, const size_t _Size) noexcept {
@@ -59,12 +72,12 @@ namespace mjx {
 
     bool _Dod_5220_22_m_ece::_Run_pass_4(byte_t* const _Buf, const size_t _Size) noexcept {
         // "pass 4: overwrite the data with pseudo random values, the DoD 5220.22-M (C) Standard"
-        return fill_with_random_bytes(_Buf, _Size);
+        return ::mjx::fill_random(_Buf, _Size);
     }
 
     bool _Dod_5220_22_m_ece::_Run_pass_5(byte_t* const _Buf, const size_t _Size) noexcept {
         // "pass 5-7: overwrite the data with DoD 5220.22-M (E) Standard"
-        return _Myeng._Reset() && _Myeng._Run_pass_1(_Buf, _Size);
+        return _Myeng._Run_pass_1(_Buf, _Size);
     }
 
     bool _Dod_5220_22_m_ece::_Run_pass_6(byte_t* const _Buf, const size_t _Size) noexcept {
@@ -77,6 +90,31 @@ namespace mjx {
         return _Myeng._Run_pass_3(_Buf, _Size);
     }
 
+    bool _Dod_5220_22_m_ece::_Prepare_pass(const uint8_t _Which) noexcept {
+        // Note: The fixed value must be generated once per pass, otherwise the data would be
+        //       overwritten with a different value in each chunk and the second pass would only
+        //       complement the value of the last chunk.
+        switch (_Which) {
+        case 1:
+        case 5:
+            return _Myeng._Reset();
+        default:
+            return true;
+        }
+    }
+
+    bool _Dod_5220_22_m_ece::_Is_constant_pass(const uint8_t _Which) noexcept {
+        switch (_Which) {
+        case 1:
+        case 2:
+        case 5:
+        case 6:
+            return true;
+        default:
+            return false;
+        }
+    }
+
     bool _Dod_5220_22_m_ece::_Run_pass(
         byte_t* const _Buf, const size_t _Size, const uint8_t _Which) noexcept {
         switch (_Which) {
@@ -99,34 +137,140 @@ namespace mjx {
         }
     }
 
-    _File_shredder::_File_shredder(file& _File) noexcept : _Myfile(_File), _Myeng() {}
+    byte_t _Dod_5220_22_m_ece::_Fixed_value() const noexcept {
+        return _Myeng._Fixed_value();
+    }
+
+    void _Dod_5220_22_m_ece::_Restore(const byte_t _Val) noexcept {
+        _Myeng._Restore(_Val);
+    }
+
+    shred_settings default_shred_settings() noexcept {
+        return shred_settings{shred_method::dod_5220_22_m_ece, shred_engine::buffered, 0,
+            durability_policy::flush_per_pass, 16, false, verify_mode::none, 100, false, false};
+    }
+
+    _File_shredder::_File_shredder(file& _File, const shred_context& _Context) noexcept
+        : _Myfile(_File), _Myeng(), _Mystream(), _Myctx(_Context), _Mymeta(), _Myresume_pass(0),
+        _Myresume_offset(0), _Myunflushed_bytes(0), _Myunflushed_time(0) {
+        if (_Context.metadata) { // queried by the producer
+            _Mymeta = *_Context.metadata;
+        } else {
+            ::mjx::query_file_metadata(_File, _Mymeta);
+        }
+    }
 
     _File_shredder::~_File_shredder() noexcept {}
 
-    bool _File_shredder::_Run_pass(const uint8_t _Which, file_stream& _Stream) noexcept {
-        uint64_t _Remaining = _Myfile.size();
-        if (_Remaining == 0) { // no data to overwrite, do nothing
+    uint8_t _File_shredder::_First_pass() const noexcept {
+        return _Myctx.settings.method == shred_method::nist_800_88_clear ? _Zero_pass : 1;
+    }
+
+    uint8_t _File_shredder::_Last_pass() const noexcept {
+        return _Myctx.settings.method == shred_method::nist_800_88_clear ? _Zero_pass : 7;
+    }
+
+    bool _File_shredder::_Is_constant_pass(const uint8_t _Which) noexcept {
+        return _Which == _Zero_pass || _Dod_5220_22_m_ece::_Is_constant_pass(_Which);
+    }
+
+    bool _File_shredder::_Pattern(
+        const uint8_t _Which, const uint64_t _Offset, byte_t* const _Buf, const size_t _Size) noexcept {
+        if (_Which == _Zero_pass) {
+            ::mjx::fill_constant(_Buf, _Size, 0);
             return true;
         }
 
-        static constexpr size_t _Buf_size = 4096;
-        byte_t _Buf[_Buf_size];
+        if (_Myctx.settings.seeded_random && !_Is_constant_pass(_Which)) { // each pass has its own stream
+            ::mjx::fill_keystream(_Mystream, _Which, _Offset, _Buf, _Size);
+            return true;
+        }
+
+        return _Myeng._Run_pass(_Buf, _Size, _Which);
+    }
+
+    bool _File_shredder::_Fill(
+        const uint8_t _Which, const uint64_t _Offset, byte_t* const _Buf, const size_t _Size) noexcept {
+        const ::std::chrono::steady_clock::time_point _Start = ::std::chrono::steady_clock::now();
+        const bool _Result = _Pattern(_Which, _Offset, _Buf, _Size);
+        if (_Myctx.stats) {
+            _Myctx.stats->fill_time += ::std::chrono::steady_clock::now() - _Start;
+        }
+
+        return _Result;
+    }
+
+    bool _File_shredder::_Run_pass(const uint8_t _Which, const uint64_t _Start, file_stream& _Stream,
+        _Write_behind& _Writeback, byte_t* const _Buf, const size_t _Buf_size) noexcept {
+        const uint64_t _Size = _Mymeta.size;
+        if (_Start >= _Size) { // no data to overwrite, do nothing
+            return true;
+        }
+
+        // Note: A non-cached write must start and end at a sector boundary. An interrupted pass
+        //       continues from the preceding boundary and the last chunk is written up to the next
+        //       one. The file is then shrunk back to its size.
+        const uint64_t _Aligned_start =
+            _Myctx.settings.bypass_cache ? _Start - _Start % _Sector_alignment : _Start;
+        uint64_t _Remaining           = _Size - _Aligned_start;
         size_t _Chunk_size;
-        if (!_Stream.seek(0)) { // start from the beginning
+        size_t _Write_size;
+        ::std::chrono::steady_clock::time_point _Write_start;
+        ::std::chrono::steady_clock::duration _Latency;
+        if (!_Stream.seek(_Aligned_start)) { // continue where the pass was interrupted
             return false;
         }
-        
+
+        // Note: A constant pattern is the same in every chunk, so the buffer is filled only once
+        //       and then written repeatedly. Only random passes generate new data for each chunk.
+        const bool _Constant = _Is_constant_pass(_Which);
+        if (_Constant && !_Fill(_Which, 0, _Buf, _Buf_size)) {
+            return false;
+        }
+
+        sha256_hash _Hash;
+        if (_Start == 0 && !_Start_digest(_Hash)) { // the digest must cover the whole pass
+            return false;
+        }
+
         while (_Remaining > 0) {
+            if (_Cancelled()) { // stop at the chunk boundary, the data written so far is made durable
+                _Writeback._Wait(); // the barrier of the stop covers the data even if the wait failed
+                return _Stop(_Which, _Size - _Remaining, _Stream, false);
+            }
+
 #ifdef _M_X64
             _Chunk_size = (::std::min)(_Buf_size, _Remaining);
 #else // ^^^ _M_X64 ^^^ / vvv _M_IX86 vvv
             _Chunk_size = (::std::min)(_Buf_size, static_cast<size_t>(_Remaining));
 #endif // _M_X64
-            if (!_Myeng._Run_pass(_Buf, _Chunk_size, _Which)) {
+            _Write_size = _Myctx.settings.bypass_cache
+                ? (_Chunk_size + _Sector_alignment - 1) & ~(_Sector_alignment - 1) : _Chunk_size;
+            if (_Constant) { // the buffer has been filled once, only hash the chunk
+                if (!_Digest(_Hash, _Buf, _Chunk_size)) {
+                    return false;
+                }
+            } else if (!_Fill_and_digest(_Which, _Size - _Remaining, _Buf, _Write_size, _Chunk_size, _Hash)) {
                 return false;
             }
 
-            if (!_Stream.write(_Buf, _Chunk_size)) {
+            if (_Myctx.throttle) { // wait until the write fits within the limits
+                _Myctx.throttle->acquire_write(_Write_size);
+            }
+
+            _Write_start = ::std::chrono::steady_clock::now();
+            if (!_Stream.write(_Buf, _Write_size)) {
+                return false;
+            }
+
+            _Latency = ::std::chrono::steady_clock::now() - _Write_start;
+            _Account_write(_Write_size, _Latency);
+            if (_Myctx.stats) {
+                _Myctx.stats->bytes_written += _Write_size;
+                _Myctx.stats->write_time += _Latency;
+            }
+
+            if (!_Writeback._Advance(_Chunk_size)) {
                 return false;
             }
 
@@ -135,9 +279,446 @@ namespace mjx {
 #else // ^^^ _M_X64 ^^^ / vvv _M_IX86 vvv
             _Remaining -= static_cast<uint64_t>(_Chunk_size);
 #endif // _M_X64
+            if (_Remaining > 0 && (_Size - _Remaining) % _Checkpoint_interval == 0) {
+                if (!_Checkpoint(_Which, _Size - _Remaining,
+                    _Myctx.settings.durability == durability_policy::write_through)) {
+                    return false;
+                }
+            }
+        }
+
+        if (!_Writeback._Wait()) { // most of the data should already be written back
+            return false;
+        }
+
+        if (_Myctx.settings.bypass_cache && _Size % _Sector_alignment != 0 && !_Myfile.resize(_Size)) {
+            return false; // the last chunk extended the file
+        }
+
+        if (!_Finish_digest(_Which, _Hash)) {
+            return false;
+        }
+
+        return _Barrier(_Which, _Stream, false) && _Verify(_Which);
+    }
+
+    bool _File_shredder::_Run_mapped_fill(void* const _Args) noexcept {
+        _Mapped_fill& _Fill = *static_cast<_Mapped_fill*>(_Args);
+        return _Fill._Shredder->_Fill_and_digest(
+            _Fill._Which, _Fill._Offset, _Fill._View, _Fill._Size, _Fill._Size, *_Fill._Hash);
+    }
+
+    bool _File_shredder::_Run_mapped_pass(const uint8_t _Which, const uint64_t _Start,
+        _File_mapping& _Mapping, file_stream& _Stream) noexcept {
+        // Note: The pattern is generated directly in the mapped pages, so no copy from a private
+        //       buffer is needed. Each window is filled in chunks, so that the throttle and
+        //       the controller still see a steady flow of writes. A view must start at a multiple
+        //       of the granularity, so an interrupted pass continues from the preceding multiple.
+        //       A page that is not resident is read from the file before it can be overwritten,
+        //       so unlike the buffered engine, the mapped one reads every byte before writing it.
+        static constexpr size_t _Chunk_size = 1024 * 1024;
+        const uint64_t _Size                = _Mymeta.size;
+        uint64_t _Offset                    = _Start - _Start % _File_mapping::_Granularity;
+        size_t _Window_size;
+        size_t _Filled;
+        size_t _Fill_size;
+        byte_t* _View;
+        _Mapped_fill _Args;
+        ::std::chrono::steady_clock::time_point _Write_start;
+        ::std::chrono::steady_clock::duration _Latency;
+        sha256_hash _Hash;
+        if (_Start == 0 && !_Start_digest(_Hash)) { // the digest must cover the whole pass
+            return false;
+        }
+
+        while (_Offset < _Size) {
+            _Window_size = static_cast<size_t>((::std::min)(
+                static_cast<uint64_t>(_File_mapping::_Window_size), _Size - _Offset));
+            _View        = _Mapping._Map(_Offset, _Window_size);
+            if (!_View) {
+                return false;
+            }
+
+            for (_Filled = 0; _Filled < _Window_size; _Filled += _Fill_size) {
+                if (_Cancelled()) { // stop at the chunk boundary, the rest of the view is untouched
+                    if (!_File_mapping::_Unmap(_View, _Window_size)) {
+                        return false;
+                    }
+
+                    return _Stop(_Which, _Offset + _Filled, _Stream, true);
+                }
+
+                _Fill_size = (::std::min)(_Chunk_size, _Window_size - _Filled);
+                if (_Myctx.throttle) { // wait until the write fits within the limits
+                    _Myctx.throttle->acquire_write(_Fill_size);
+                }
+
+                _Args = {this, _Which, _Offset + _Filled, _View + _Filled, _Fill_size, &_Hash};
+                if (!::mjx::_Guard_mapped_access(&_File_shredder::_Run_mapped_fill, &_Args)) {
+                    _File_mapping::_Unmap(_View, _Window_size);
+                    return false;
+                }
+
+                _Myunflushed_bytes += _Fill_size; // the pages are written back lazily
+                if (_Myctx.stats) { // filling the mapping is measured as a fill, not as a write
+                    _Myctx.stats->bytes_written += _Fill_size;
+                }
+            }
+
+            _Write_start = ::std::chrono::steady_clock::now();
+            if (!_File_mapping::_Unmap(_View, _Window_size)) {
+                return false;
+            }
+
+            _Latency = ::std::chrono::steady_clock::now() - _Write_start;
+            _Myunflushed_time += _Latency;
+            if (_Myctx.stats) {
+                _Myctx.stats->write_time += _Latency;
+            }
+
+            _Offset += _Window_size;
+            if (_Offset < _Size && _Offset % _Checkpoint_interval == 0) { // the view is written back lazily
+                if (!_Checkpoint(_Which, _Offset, false)) {
+                    return false;
+                }
+            }
+        }
+
+        return _Finish_digest(_Which, _Hash) && _Barrier(_Which, _Stream, true) && _Verify(_Which);
+    }
+
+    bool _File_shredder::_Load_progress() noexcept {
+        _Myresume_pass   = _First_pass();
+        _Myresume_offset = 0;
+        if (!_Myctx.journal) { // progress not recorded, start from the beginning
+            return true;
+        }
+
+        // Note: The progress is only trusted if it was recorded for the same method and the file size
+        //       has not changed since. Otherwise the file is shredded from the beginning.
+        const journal_entry _Entry = _Myctx.journal->read(_Myctx.journal_slot);
+        if (_Entry.state == journal_state::in_progress
+            && _Entry.method == static_cast<uint8_t>(_Myctx.settings.method)
+            && _Entry.size == _Mymeta.size && _Entry.offset <= _Entry.size
+            && _Entry.pass >= _First_pass() && _Entry.pass <= _Last_pass() + 1) {
+            _Myresume_pass   = _Entry.pass;
+            _Myresume_offset = _Entry.offset;
+            _Myeng._Restore(_Entry.fixed_value); // the second and sixth pass write the complement of it
+            if (_Myctx.stats) {
+                _Myctx.stats->resumed        = true;
+                _Myctx.stats->resumed_pass   = _Myresume_pass;
+                _Myctx.stats->resumed_offset = _Myresume_offset;
+            }
+
+            return true;
+        }
+
+        return _Checkpoint(_Myresume_pass, 0, true); // nothing has been written yet
+    }
+
+    uint64_t _File_shredder::_Start_offset(const uint8_t _Which) const noexcept {
+        return _Which == _Myresume_pass ? _Myresume_offset : 0;
+    }
+
+    bool _File_shredder::_Checkpoint(
+        const uint8_t _Which, const uint64_t _Offset, const bool _Durable) noexcept {
+        if (!_Myctx.journal || _Myctx.settings.durability == durability_policy::flush_per_group) {
+            return true; // the data is flushed with the whole group, only the completion is recorded
+        }
+
+        // Note: The journal must never get ahead of the device. Unless the data has already been made
+        //       durable, it is flushed before the progress is recorded.
+        if (!_Durable) {
+            const ::std::chrono::steady_clock::time_point _Start = ::std::chrono::steady_clock::now();
+            if (!::mjx::flush_file_data(_Myfile)) {
+                return false;
+            }
+
+            _Account_durable(::std::chrono::steady_clock::now() - _Start);
+        }
+
+        return _Record_progress(_Which, _Offset);
+    }
+
+    bool _File_shredder::_Record_progress(const uint8_t _Which, const uint64_t _Offset) noexcept {
+        if (!_Myctx.journal) {
+            return true;
+        }
+
+        journal_entry _Entry = _Myctx.journal->read(_Myctx.journal_slot);
+        _Entry.state         = journal_state::in_progress;
+        _Entry.method        = static_cast<uint8_t>(_Myctx.settings.method);
+        _Entry.pass          = _Which;
+        _Entry.fixed_value   = _Myeng._Fixed_value();
+        _Entry.size          = _Mymeta.size;
+        _Entry.offset        = _Offset;
+        return _Myctx.journal->write(_Myctx.journal_slot, _Entry);
+    }
+
+    bool _File_shredder::_Cancelled() const noexcept {
+        return _Myctx.cancel && _Myctx.cancel->requested();
+    }
+
+    bool _File_shredder::_Record_stop(const uint8_t _Which, const uint64_t _Offset) noexcept {
+        if (_Myctx.stats) {
+            _Myctx.stats->cancelled      = true;
+            _Myctx.stats->stopped_pass   = _Which;
+            _Myctx.stats->stopped_offset = _Offset;
+        }
+
+        return false;
+    }
+
+    bool _File_shredder::_Stop(
+        const uint8_t _Which, const uint64_t _Offset, file_stream& _Stream, const bool _Mapped) noexcept {
+        // Note: A stopped file is not finished, so it does not join a barrier group. Under the group
+        //       policy, it is flushed alone and its stop position is journaled, although that policy
+        //       takes no checkpoints otherwise. The progress is reported even if it cannot be recorded.
+        const bool _Durable = _Myctx.settings.durability == durability_policy::flush_per_group
+            ? ::mjx::flush_file_data(_Myfile) : _Barrier(_Which, _Stream, _Mapped);
+        if (_Durable) {
+            _Record_progress(_Which, _Offset);
+        }
+
+        return _Record_stop(_Which, _Offset);
+    }
+
+    bool _File_shredder::_Start_digest(sha256_hash& _Hash) noexcept {
+        return !_Myctx.settings.hash_passes || _Hash.start();
+    }
+
+    bool _File_shredder::_Digest(sha256_hash& _Hash, const byte_t* const _Data, const size_t _Size) noexcept {
+        if (!_Hash.active()) { // digests not requested, do nothing
+            return true;
+        }
+
+        const ::std::chrono::steady_clock::time_point _Start = ::std::chrono::steady_clock::now();
+        const bool _Result = _Hash.update(_Data, _Size);
+        if (_Myctx.stats) {
+            _Myctx.stats->hash_time += ::std::chrono::steady_clock::now() - _Start;
+        }
+
+        return _Result;
+    }
+
+    bool _File_shredder::_Fill_and_digest(const uint8_t _Which, const uint64_t _Offset, byte_t* const _Buf,
+        const size_t _Size, const size_t _Digest_size, sha256_hash& _Hash) noexcept {
+        if (!_Hash.active()) { // digest not requested, fill the whole buffer at once
+            return _Fill(_Which, _Offset, _Buf, _Size);
+        }
+
+        size_t _Piece_size;
+        for (size_t _Off = 0; _Off < _Size; _Off += _Piece_size) {
+            _Piece_size = (::std::min)(_Digest_piece_size, _Size - _Off);
+            if (!_Fill(_Which, _Offset + _Off, _Buf + _Off, _Piece_size)) {
+                return false;
+            }
+
+            if (_Off < _Digest_size
+                && !_Digest(_Hash, _Buf + _Off, (::std::min)(_Piece_size, _Digest_size - _Off))) {
+                return false;
+            }
+        }
+
+        return true;
+    }
+
+    bool _File_shredder::_Finish_digest(const uint8_t _Which, sha256_hash& _Hash) noexcept {
+        if (!_Hash.active()) { // digests not requested, do nothing
+            return true;
+        }
+
+        byte_t _Digest[sha256_digest_size];
+        if (!_Hash.finish(_Digest)) {
+            return false;
+        }
+
+        if (_Myctx.stats) {
+            ::memcpy(_Myctx.stats->pass_digests[_Which], _Digest, sha256_digest_size);
+            _Myctx.stats->hashed_passes |= static_cast<uint8_t>(1 << _Which);
+        }
+
+        return true;
+    }
+
+    void _File_shredder::_Account_write(
+        const size_t _Size, const ::std::chrono::steady_clock::duration _Time) noexcept {
+        _Myunflushed_bytes += _Size;
+        _Myunflushed_time += _Time;
+        if (_Myctx.settings.durability == durability_policy::write_through) { // already on the device
+            _Account_durable(::std::chrono::steady_clock::duration{0});
+        }
+    }
+
+    void _File_shredder::_Account_durable(const ::std::chrono::steady_clock::duration _Flush_time) noexcept {
+        // Note: A buffered write only copies the data into the system cache, so timing it alone would
+        //       measure the memory. The controller is given the time spent writing the data together
+        //       with the barrier that made it durable, which is what the device actually limits.
+        if (_Myctx.controller) {
+            _Myctx.controller->record_transfer(_Myunflushed_bytes, _Myunflushed_time + _Flush_time);
         }
 
-        return _Stream.flush(); // request to immediately write data to disk
+        _Myunflushed_bytes = 0;
+        _Myunflushed_time  = ::std::chrono::steady_clock::duration{0};
+    }
+
+    bool _File_shredder::_Barrier(const uint8_t _Which, file_stream& _Stream, const bool _Mapped) noexcept {
+        const ::std::chrono::steady_clock::time_point _Start = ::std::chrono::steady_clock::now();
+        bool _Result;
+        switch (_Myctx.settings.durability) {
+        case durability_policy::data_flush_per_pass:
+            _Result = ::mjx::flush_file_data(_Myfile);
+            break;
+        case durability_policy::write_through: // the written data has already reached the device
+            _Result = _Mapped ? _Stream.flush() : true; // but the mapped data is written back lazily
+            break;
+        case durability_policy::flush_per_group:
+            // Note: Without a barrier between the passes, the caches could merge them and only
+            //       the last pass would reach the media. Only the final barrier is shared by the group,
+            //       the scheduler flushes the whole group at once.
+            if (_Which == _Last_pass()) {
+                return true;
+            }
+
+            _Result = ::mjx::flush_file_data(_Myfile);
+            break;
+        default:
+            _Result = _Stream.flush(); // request to immediately write data to disk
+            break;
+        }
+
+        const ::std::chrono::steady_clock::duration _Time = ::std::chrono::steady_clock::now() - _Start;
+        if (_Myctx.stats) {
+            _Myctx.stats->barrier_time += _Time;
+        }
+
+        if (_Result) {
+            _Account_durable(_Time);
+        }
+
+        return _Result;
+    }
+
+    bool _File_shredder::_Can_verify_pass(const uint8_t _Which) const noexcept {
+        // Note: The random patterns are not kept anywhere. Unless they are generated from the per-job key,
+        //       which reproduces the bytes at any offset, only the constant patterns can be generated
+        //       again and compared with the read back data.
+        if (_Is_constant_pass(_Which)) {
+            return true;
+        }
+
+        // a resumed pass was partly written with the key of the interrupted run, which is not kept
+        return _Myctx.settings.seeded_random && _Start_offset(_Which) == 0;
+    }
+
+    bool _File_shredder::_Should_verify(const uint8_t _Which) const noexcept {
+        switch (_Myctx.settings.verification) {
+        case verify_mode::final_pass:
+            return _Which == _Last_pass();
+        case verify_mode::every_pass:
+            return true;
+        default:
+            return false;
+        }
+    }
+
+    bool _File_shredder::_Verify(const uint8_t _Which) noexcept {
+        if (!_Should_verify(_Which)) { // nothing to verify, do nothing
+            return true;
+        }
+
+        if (!_Can_verify_pass(_Which)) { // the pass is reported as not verified instead
+            if (_Myctx.stats) {
+                ++_Myctx.stats->passes_unverified;
+            }
+
+            return true;
+        }
+
+        // Note: The data is read through a separate non-cached handle, so it comes from the device
+        //       rather than from the system cache. The file system writes any data that is still cached
+        //       back before such a read, so the pass is read back even if its barrier is deferred.
+        const ::std::chrono::steady_clock::time_point _Start = ::std::chrono::steady_clock::now();
+        _Read_back _Reader(_Myfile);
+        if (!_Reader._Valid()) {
+            return false;
+        }
+
+        byte_t* const _Expected = _Reader._Expected();
+        const bool _Constant    = _Is_constant_pass(_Which);
+        if (_Constant && !_Pattern(_Which, 0, _Expected, _Read_back::_Chunk_size)) { // same in every chunk
+            return false;
+        }
+
+        // Note: A full verification reads the pass in large chunks. A sampled one reads smaller blocks,
+        //       so that the same coverage is spread over more places of the file.
+        const uint64_t _Size     = _Mymeta.size;
+        const bool _Sampled      = _Myctx.settings.verify_coverage < 100;
+        const size_t _Block_size = _Sampled ? _Block_sampler::_Block_size : _Read_back::_Chunk_size;
+        _Block_sampler _Sampler((_Size + _Block_size - 1) / _Block_size, _Myctx.settings.verify_coverage);
+        if (_Sampled && !_Sampler._Seed()) {
+            return false;
+        }
+
+        uint64_t _Verified   = 0;
+        uint64_t _Mismatches = 0;
+        uint64_t _Block      = 0;
+        size_t _Chunk_size;
+        for (uint64_t _Offset = 0; _Offset < _Size; _Offset += _Chunk_size, ++_Block) {
+            _Chunk_size = static_cast<size_t>(
+                (::std::min)(static_cast<uint64_t>(_Block_size), _Size - _Offset));
+            if (!_Sampler._Selected(_Block)) { // not sampled, skip the block
+                continue;
+            }
+
+            if (_Cancelled()) { // the pass has been written completely, only its verification is stopped
+                if (_Myctx.settings.durability != durability_policy::flush_per_group
+                    || ::mjx::flush_file_data(_Myfile)) { // flushed alone, as _Stop() does
+                    _Record_progress(_Which + 1, 0);
+                }
+
+                return _Record_stop(_Which + 1, 0);
+            }
+
+            if (!_Reader._Read(_Offset, _Chunk_size)) {
+                return false;
+            }
+
+            if (!_Constant && !_Pattern(_Which, _Offset, _Expected, _Chunk_size)) {
+                return false;
+            }
+
+            if (!::mjx::equal_buffers(_Reader._Data(), _Expected, _Chunk_size)) {
+                ++_Mismatches;
+            }
+
+            _Verified += _Chunk_size;
+        }
+
+        if (_Myctx.stats) {
+            ++_Myctx.stats->passes_verified;
+            _Myctx.stats->bytes_verified += _Verified;
+            _Myctx.stats->bytes_verifiable += _Size;
+            _Myctx.stats->mismatches += _Mismatches;
+            _Myctx.stats->verify_time += ::std::chrono::steady_clock::now() - _Start;
+        }
+
+        return _Mismatches == 0;
+    }
+
+    bool _File_shredder::_Offload_zero_pass() noexcept {
+        const ::std::chrono::steady_clock::time_point _Start = ::std::chrono::steady_clock::now();
+        if (!::mjx::zero_file_data(_Myfile, _Mymeta)) { // write the zeros the usual way
+            return false;
+        }
+
+        if (_Myctx.stats) {
+            _Myctx.stats->zeroing_offloaded = true;
+            _Myctx.stats->bytes_written += _Mymeta.size;
+            _Myctx.stats->write_time += ::std::chrono::steady_clock::now() - _Start;
+        }
+
+        return true;
     }
 
     bool _File_shredder::_Shred() noexcept {
@@ -146,8 +727,67 @@ namespace mjx {
             return false;
         }
 
-        for (uint8_t _Which = 1; _Which <= 7; ++_Which) {
-            if (!_Run_pass(_Which, _Stream)) {
+        if (_Myctx.settings.seeded_random && !_Mystream.seed()) { // every file gets a different key
+            return false;
+        }
+
+        if (_Myctx.stats) {
+            _Myctx.stats->file_size = _Mymeta.size;
+        }
+
+        if (!_Load_progress()) {
+            return false;
+        }
+
+        if (_Myresume_pass > _Last_pass()) { // overwritten by an interrupted run, only the cleanup is left
+            return true;
+        }
+
+        if (_Cancelled()) { // nothing has been written, nothing has to be made durable
+            return _Record_stop(_Myresume_pass, _Myresume_offset);
+        }
+
+        if (_Myctx.settings.method == shred_method::nist_800_88_clear && _Offload_zero_pass()) {
+            return _Barrier(_Zero_pass, _Stream, false) && _Verify(_Zero_pass)
+                && _Checkpoint(_Zero_pass + 1, 0, true);
+        }
+
+        if (_Myctx.settings.engine == shred_engine::mapped && ::mjx::_Can_map_file(_Mymeta)) {
+            _File_mapping _Mapping(_Myfile);
+            if (_Mapping._Valid()) { // otherwise fall back to the buffered engine
+                if (_Myctx.stats) {
+                    _Myctx.stats->engine = shred_engine::mapped;
+                }
+
+                for (uint8_t _Which = _Myresume_pass; _Which <= _Last_pass(); ++_Which) {
+                    if ((_Start_offset(_Which) == 0 && !_Myeng._Prepare_pass(_Which))
+                        || !_Run_mapped_pass(_Which, _Start_offset(_Which), _Mapping, _Stream)
+                        || !_Checkpoint(_Which + 1, 0, true)) {
+                        return false;
+                    }
+                }
+
+                return true;
+            }
+        }
+
+        if (_Myctx.stats) {
+            _Myctx.stats->engine = shred_engine::buffered;
+        }
+
+        // Note: A buffer from the pool is larger, so fewer writes are needed, and it never faults.
+        //       If the pool is exhausted, the shredder waits for a free buffer. Only if the pool is not
+        //       used, a small buffer on the stack is used instead.
+        //       Both are aligned to the sector size, as non-cached writes require.
+        alignas(_Sector_alignment) byte_t _Local_buf[_Sector_alignment];
+        _Pooled_buffer _Pooled(_Myctx.buffers);
+        byte_t* const _Buf     = _Pooled._Get() ? _Pooled._Get() : _Local_buf;
+        const size_t _Buf_size = _Pooled._Get() ? _Pooled._Size() : sizeof(_Local_buf);
+        _Write_behind _Writeback(_Myfile, _Myctx.settings.write_behind_window);
+        for (uint8_t _Which = _Myresume_pass; _Which <= _Last_pass(); ++_Which) {
+            if ((_Start_offset(_Which) == 0 && !_Myeng._Prepare_pass(_Which))
+                || !_Run_pass(_Which, _Start_offset(_Which), _Stream, _Writeback, _Buf, _Buf_size)
+                || !_Checkpoint(_Which + 1, 0, true)) {
                 return false;
             }
         }
@@ -155,8 +795,8 @@ namespace mjx {
         return true;
     }
 
-    bool securely_shred_file(file& _File) noexcept {
-        _File_shredder _Shredder(_File);
+    bool securely_shred_file(file& _File, const shred_context& _Context) noexcept {
+        _File_shredder _Shredder(_File, _Context);
         return _Shredder._Shred() && _File.resize(0);
     }
 } // namespace mjx
\ No newline at end of file
@@ -6,9 +6,20 @@
 #pragma once
 #ifndef _FSHRED_SHREDDER_HPP_
 #define _FSHRED_SHREDDER_HPP_
+#include <chrono>
 #include <cstddef>
 #include <cstdint>
+#include <fshred/buffer.hpp>
+#include <fshred/cancel.hpp>
+#include <fshred/controller.hpp>
+#include <fshred/hash.hpp>
+#include <fshred/identity.hpp>
+#include <fshred/journal.hpp>
+#include <fshred/mapping.hpp>
+#include <fshred/random.hpp>
+#include <fshred/throttle.hpp>
 #include <fshred/utils.hpp>
+#include <fshred/writeback.hpp>
 #include <mjfs/file.hpp>
 #include <mjfs/file_stream.hpp>
 
@@ -30,6 +41,12 @@ namespace mjx {
         // resets the fixed value
         bool _Reset() noexcept;
 
+        // returns the fixed value
+        byte_t _Fixed_value() const noexcept;
+
+        // restores the fixed value of an interrupted pass
+        void _Restore(const byte_t _Val) noexcept;
+
     private:
         // generates a new fixed value
         static bool _Get_fixed_value(byte_t& _Val) noexcept;
@@ -63,30 +80,229 @@ namespace mjx {
         // runs the seventh pass of DoD 5220.22-M (ECE)
         bool _Run_pass_7(byte_t* const _Buf, const size_t _Size) noexcept;
 
+        // prepares the specified pass (1-7), must be called once before the pass
+        bool _Prepare_pass(const uint8_t _Which) noexcept;
+
+        // checks whether the specified pass (1-7) writes the same value to every byte
+        static bool _Is_constant_pass(const uint8_t _Which) noexcept;
+
         // runs the specified pass (1-7)
         bool _Run_pass(byte_t* const _Buf, const size_t _Size, const uint8_t _Which) noexcept;
 
+        // returns the fixed value of the constant passes
+        byte_t _Fixed_value() const noexcept;
+
+        // restores the fixed value of an interrupted pass
+        void _Restore(const byte_t _Val) noexcept;
+
     private:
         _Dod_5220_22_m_e _Myeng; // runs 1-3 and 5-7 passes
     };
     
+    enum class durability_policy : unsigned char {
+        flush_per_pass, // flushes the data and metadata after every pass
+        data_flush_per_pass, // flushes only the data after every pass
+        write_through, // every write reaches the device before it completes, no flush needed
+        flush_per_group // flushes the data between passes, the final barrier is shared by a group of files
+    };
+
+    enum class shred_method : unsigned char {
+        dod_5220_22_m_ece, // 7 passes of DoD 5220.22-M (ECE)
+        nist_800_88_clear // a single pass of zeros, as NIST SP 800-88 Clear
+    };
+
+    enum class shred_engine : unsigned char {
+        buffered, // writes the data through a file stream
+        mapped // fills the data directly in a mapping of the file
+    };
+
+    enum class verify_mode : unsigned char {
+        none, // trusts the results of the writes
+        final_pass, // reads back the last pass
+        every_pass // reads back every pass
+    };
+
+    struct shred_settings { // per-job shredding settings
+        shred_method method;
+        shred_engine engine;
+        uint64_t write_behind_window; // bytes written before their writeback starts, 0 if disabled
+        durability_policy durability;
+        size_t barrier_group_size; // number of files flushed at once by flush_per_group
+        bool bypass_cache; // writes directly to the device, so the data never enters the system cache
+        verify_mode verification;
+        uint32_t verify_coverage; // percentage of the blocks read back, 100 reads back the whole pass
+        bool seeded_random; // generates the random passes from a per-job key, so they can be verified
+        bool hash_passes; // computes a SHA-256 digest of the data written by every pass
+    };
+
+    struct shred_stats { // measurements of a single file
+        shred_engine engine; // engine actually used, the mapped one may fall back to the buffered one
+        bool zeroing_offloaded; // the zeros have been written by the file system
+        uint64_t bytes_written;
+        ::std::chrono::steady_clock::duration fill_time; // time spent generating the patterns
+        ::std::chrono::steady_clock::duration write_time;
+        ::std::chrono::steady_clock::duration barrier_time; // time spent waiting for flushes
+        uint32_t passes_verified;
+        uint32_t passes_unverified; // passes selected for verification whose content cannot be generated
+        uint64_t bytes_verified; // bytes read back and compared
+        uint64_t bytes_verifiable; // size of all verified passes, the coverage is relative to it
+        uint64_t mismatches; // number of read back blocks that differ from the expected pattern
+        ::std::chrono::steady_clock::duration verify_time;
+        uint64_t file_size; // size of the file before shredding
+        ::std::chrono::system_clock::time_point started;
+        ::std::chrono::system_clock::time_point finished;
+        uint8_t hashed_passes; // bit mask of the passes with a digest
+        byte_t pass_digests[8][sha256_digest_size]; // indexed by the pass
+        ::std::chrono::steady_clock::duration hash_time;
+        bool resumed; // continued from the progress of an interrupted run
+        uint8_t resumed_pass;
+        uint64_t resumed_offset;
+        bool cancelled; // stopped on request, the file is only partly overwritten
+        uint8_t stopped_pass; // pass that was running when the file was stopped
+        uint64_t stopped_offset; // number of durable bytes of the stopped pass
+    };
+
+    struct shred_context { // settings and services used while shredding a file
+        shred_settings settings;
+        io_throttle* throttle; // limits the write rate, may be null
+        concurrency_controller* controller; // observes how fast the data reaches the device, may be null
+        shred_stats* stats; // receives the measurements, may be null
+        buffer_pool* buffers; // provides the write buffers, may be null
+        shred_progress* journal; // records the progress of the file, may be null
+        size_t journal_slot; // entry of the file in the journal
+        const cancellation_token* cancel; // stops the file at the next chunk boundary, may be null
+        const file_metadata* metadata; // queried when the file was opened, may be null
+    };
+
+    // returns the default settings
+    shred_settings default_shred_settings() noexcept;
+
     class _File_shredder {
     public:
-        explicit _File_shredder(file& _File) noexcept;
+        _File_shredder(file& _File, const shred_context& _Context) noexcept;
         ~_File_shredder() noexcept;
 
         // tries to securely shred the file
         bool _Shred() noexcept;
 
     private:
-        // runs the specified pass through all data
-        bool _Run_pass(const uint8_t _Which, file_stream& _Stream) noexcept;
+        // returns the first pass of the method
+        uint8_t _First_pass() const noexcept;
+
+        // returns the last pass of the method
+        uint8_t _Last_pass() const noexcept;
+
+        // checks whether the specified pass writes the same value to every byte
+        static bool _Is_constant_pass(const uint8_t _Which) noexcept;
+
+        // lets the file system write the zero pass, fails if it cannot be offloaded
+        bool _Offload_zero_pass() noexcept;
+
+        // generates the pattern of the specified pass at the offset into the buffer
+        bool _Pattern(
+            const uint8_t _Which, const uint64_t _Offset, byte_t* const _Buf, const size_t _Size) noexcept;
+
+        // fills the buffer with the pattern of the specified pass at the offset, measures the time spent
+        bool _Fill(
+            const uint8_t _Which, const uint64_t _Offset, byte_t* const _Buf, const size_t _Size) noexcept;
+
+        // runs the specified pass from the offset to the end of the file, writes chunks of the buffer size
+        bool _Run_pass(const uint8_t _Which, const uint64_t _Start, file_stream& _Stream,
+            _Write_behind& _Writeback, byte_t* const _Buf, const size_t _Buf_size) noexcept;
+
+        struct _Mapped_fill { // arguments of a fill guarded by _Guard_mapped_access()
+            _File_shredder* _Shredder;
+            uint8_t _Which;
+            uint64_t _Offset;
+            byte_t* _View;
+            size_t _Size;
+            sha256_hash* _Hash;
+        };
+
+        // fills and hashes a part of a mapped view, called through _Guard_mapped_access()
+        static bool _Run_mapped_fill(void* const _Args) noexcept;
+
+        // runs the specified pass from the offset to the end of the file in a mapping of the file
+        bool _Run_mapped_pass(const uint8_t _Which, const uint64_t _Start,
+            _File_mapping& _Mapping, file_stream& _Stream) noexcept;
+
+        // loads the progress of an interrupted run from the journal, records the start otherwise
+        bool _Load_progress() noexcept;
+
+        // returns the offset at which the specified pass starts
+        uint64_t _Start_offset(const uint8_t _Which) const noexcept;
+
+        // records in the journal that everything before the offset of the pass is on the device
+        bool _Checkpoint(const uint8_t _Which, const uint64_t _Offset, const bool _Durable) noexcept;
+
+        // writes the progress to the journal, the caller guarantees that the data is already durable
+        bool _Record_progress(const uint8_t _Which, const uint64_t _Offset) noexcept;
+
+        // checks whether the shredding should stop
+        bool _Cancelled() const noexcept;
+
+        // records how far the file got, always fails, so that the file is not truncated
+        bool _Record_stop(const uint8_t _Which, const uint64_t _Offset) noexcept;
+
+        // makes the data written before the offset of the pass durable and stops the file
+        bool _Stop(
+            const uint8_t _Which, const uint64_t _Offset, file_stream& _Stream, const bool _Mapped) noexcept;
+
+        // starts the digest of a pass if requested
+        bool _Start_digest(sha256_hash& _Hash) noexcept;
+
+        // appends the written data to the digest of the pass
+        bool _Digest(sha256_hash& _Hash, const byte_t* const _Data, const size_t _Size) noexcept;
+
+        // fills the buffer and appends its first bytes to the digest of the pass, if one is computed
+        bool _Fill_and_digest(const uint8_t _Which, const uint64_t _Offset, byte_t* const _Buf,
+            const size_t _Size, const size_t _Digest_size, sha256_hash& _Hash) noexcept;
+
+        // stores the digest of the finished pass
+        bool _Finish_digest(const uint8_t _Which, sha256_hash& _Hash) noexcept;
+
+        // accounts written data that has not reached the device yet
+        void _Account_write(const size_t _Size, const ::std::chrono::steady_clock::duration _Time) noexcept;
+
+        // reports the data written since the last barrier to the controller, once it is durable
+        void _Account_durable(const ::std::chrono::steady_clock::duration _Flush_time) noexcept;
+
+        // makes the specified pass durable according to the policy
+        bool _Barrier(const uint8_t _Which, file_stream& _Stream, const bool _Mapped) noexcept;
+
+        // checks whether the expected content of the specified pass can be generated again
+        bool _Can_verify_pass(const uint8_t _Which) const noexcept;
+
+        // checks whether the verification mode selects the specified pass
+        bool _Should_verify(const uint8_t _Which) const noexcept;
+
+        // reads the pass back from the device and compares it with the expected pattern
+        bool _Verify(const uint8_t _Which) noexcept;
+
+        static constexpr uint8_t _Zero_pass = 0; // not a DoD 5220.22-M (ECE) pass, writes zeros
+
+        static constexpr size_t _Sector_alignment = 4096; // a multiple of every common sector size
+
+        // Note: Pieces of this size are filled through the CPU caches, so they are still cached when
+        //       they are hashed. A larger fill would bypass the caches and the digest would read it back.
+        static constexpr size_t _Digest_piece_size = 256 * 1024;
+
+        // Note: A checkpoint flushes the file data, so it is only taken every gigabyte. An interrupted run
+        //       repeats at most that much of a pass. The interval is a multiple of every chunk size.
+        static constexpr uint64_t _Checkpoint_interval = 1ULL << 30;
 
         file& _Myfile;
         _Dod_5220_22_m_ece _Myeng;
+        random_stream _Mystream; // generates the random passes if they are seeded
+        shred_context _Myctx;
+        file_metadata _Mymeta; // the size does not change while the file is being overwritten
+        uint8_t _Myresume_pass; // the first pass that has not been finished yet
+        uint64_t _Myresume_offset; // offset at which the first unfinished pass continues
+        uint64_t _Myunflushed_bytes; // bytes written since the data was last made durable
+        ::std::chrono::steady_clock::duration _Myunflushed_time; // time spent writing them
     };
 
-    bool securely_shred_file(file& _File) noexcept;
+    bool securely_shred_file(file& _File, const shred_context& _Context = shred_context{}) noexcept;
 } // namespace mjx
 
 #endif // _FSHRED_SHREDDER_HPP_
\ No newline at end of file
@@ -0,0 +1,78 @@
+// throttle.cpp
+
+// Copyright (c) Mateusz Jandura. All rights reserved.
+// SPDX-License-Identifier: Apache-2.0
+
+#include <algorithm>
+#include <fshred/throttle.hpp>
+#include <thread>
+
+namespace mjx {
+    token_bucket::token_bucket() noexcept : _Mymtx(), _Myrate(0), _Mytokens(0.0), _Mylast(_Clock::now()) {}
+
+    token_bucket::~token_bucket() noexcept {}
+
+    void token_bucket::_Refill(const _Clock::time_point _Now) noexcept {
+        const double _Rate    = static_cast<double>(_Myrate);
+        const double _Elapsed = ::std::chrono::duration<double>(_Now - _Mylast).count();
+        _Mytokens             = (::std::min)(_Rate, _Mytokens + _Elapsed * _Rate); // capacity of one second
+        _Mylast               = _Now;
+    }
+
+    uint64_t token_bucket::rate() const noexcept {
+        ::std::lock_guard<::std::mutex> _Guard(_Mymtx);
+        return _Myrate;
+    }
+
+    void token_bucket::rate(const uint64_t _New_rate) noexcept {
+        ::std::lock_guard<::std::mutex> _Guard(_Mymtx);
+        _Refill(_Clock::now()); // settle the tokens accumulated at the old rate
+        _Myrate   = _New_rate;
+        _Mytokens = (::std::min)(_Mytokens, static_cast<double>(_New_rate));
+    }
+
+    void token_bucket::acquire(const uint64_t _Count) noexcept {
+        double _Delay; // in seconds
+        {
+            ::std::lock_guard<::std::mutex> _Guard(_Mymtx);
+            if (_Myrate == 0) { // unlimited
+                return;
+            }
+
+            // Note: The tokens are taken immediately, even if the bucket goes into debt. Concurrent
+            //       callers then wait in the order they came, and requests larger than the capacity
+            //       are still served.
+            _Refill(_Clock::now());
+            _Mytokens -= static_cast<double>(_Count);
+            if (_Mytokens >= 0.0) {
+                return;
+            }
+
+            _Delay = -_Mytokens / static_cast<double>(_Myrate);
+        }
+
+        ::std::this_thread::sleep_for(::std::chrono::duration<double>(_Delay));
+    }
+
+    io_throttle::io_throttle(io_throttle* const _Parent) noexcept
+        : _Myparent(_Parent), _Mybytes(), _Mywrites() {}
+
+    io_throttle::~io_throttle() noexcept {}
+
+    io_limits io_throttle::limits() const noexcept {
+        return {_Mybytes.rate(), _Mywrites.rate()};
+    }
+
+    void io_throttle::limits(const io_limits& _New_limits) noexcept {
+        _Mybytes.rate(_New_limits.bytes_per_second);
+        _Mywrites.rate(_New_limits.writes_per_second);
+    }
+
+    void io_throttle::acquire_write(const size_t _Size) noexcept {
+        _Mybytes.acquire(static_cast<uint64_t>(_Size));
+        _Mywrites.acquire(1);
+        if (_Myparent) {
+            _Myparent->acquire_write(_Size);
+        }
+    }
+} // namespace mjx
\ No newline at end of file
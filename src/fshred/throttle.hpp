@@ -0,0 +1,73 @@
+// throttle.hpp
+
+// Copyright (c) Mateusz Jandura. All rights reserved.
+// SPDX-License-Identifier: Apache-2.0
+
+#pragma once
+#ifndef _FSHRED_THROTTLE_HPP_
+#define _FSHRED_THROTTLE_HPP_
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+
+namespace mjx {
+    class token_bucket { // thread-safe token bucket, refilled at a constant rate
+    public:
+        token_bucket() noexcept;
+        ~token_bucket() noexcept;
+
+        token_bucket(const token_bucket&)            = delete;
+        token_bucket& operator=(const token_bucket&) = delete;
+
+        // returns the number of tokens added per second, 0 if unlimited
+        uint64_t rate() const noexcept;
+
+        // changes the number of tokens added per second, 0 disables the limit
+        void rate(const uint64_t _New_rate) noexcept;
+
+        // takes the tokens, waits until the bucket pays off its debt
+        void acquire(const uint64_t _Count) noexcept;
+
+    private:
+        using _Clock = ::std::chrono::steady_clock;
+
+        // adds the tokens accumulated since the last refill
+        void _Refill(const _Clock::time_point _Now) noexcept;
+
+        mutable ::std::mutex _Mymtx;
+        uint64_t _Myrate; // tokens added per second, also the bucket capacity
+        double _Mytokens; // available tokens, negative if in debt
+        _Clock::time_point _Mylast; // time of the last refill
+    };
+
+    struct io_limits {
+        uint64_t bytes_per_second; // 0 if unlimited
+        uint64_t writes_per_second; // 0 if unlimited
+    };
+
+    class io_throttle { // limits the write rate, optionally nested within a wider throttle
+    public:
+        explicit io_throttle(io_throttle* const _Parent = nullptr) noexcept;
+        ~io_throttle() noexcept;
+
+        io_throttle(const io_throttle&)            = delete;
+        io_throttle& operator=(const io_throttle&) = delete;
+
+        // returns the current limits
+        io_limits limits() const noexcept;
+
+        // changes the limits, can be called while other threads write
+        void limits(const io_limits& _New_limits) noexcept;
+
+        // waits until a write of the specified size is allowed by this and all parent throttles
+        void acquire_write(const size_t _Size) noexcept;
+
+    private:
+        io_throttle* _Myparent;
+        token_bucket _Mybytes;
+        token_bucket _Mywrites;
+    };
+} // namespace mjx
+
+#endif // _FSHRED_THROTTLE_HPP_
\ No newline at end of file
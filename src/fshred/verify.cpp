@@ -0,0 +1,79 @@
+// verify.cpp
+
+// Copyright (c) Mateusz Jandura. All rights reserved.
+// SPDX-License-Identifier: Apache-2.0
+
+#include <algorithm>
+#include <fshred/random.hpp>
+#include <fshred/verify.hpp>
+
+namespace mjx {
+    _Read_back::_Read_back(const file& _File) noexcept
+        : _Myhandle(::ReOpenFile(_File.native_handle(), GENERIC_READ,
+            FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, FILE_FLAG_NO_BUFFERING)),
+        _Mybuf(static_cast<byte_t*>(
+            ::VirtualAlloc(nullptr, 2 * _Chunk_size, MEM_COMMIT | MEM_RESERVE, PAGE_READWRITE))) {}
+
+    _Read_back::~_Read_back() noexcept {
+        if (_Myhandle != INVALID_HANDLE_VALUE) {
+            ::CloseHandle(_Myhandle);
+            _Myhandle = INVALID_HANDLE_VALUE;
+        }
+
+        if (_Mybuf) {
+            ::VirtualFree(_Mybuf, 0, MEM_RELEASE);
+            _Mybuf = nullptr;
+        }
+    }
+
+    bool _Read_back::_Valid() const noexcept {
+        return _Myhandle != INVALID_HANDLE_VALUE && _Mybuf != nullptr;
+    }
+
+    bool _Read_back::_Read(const uint64_t _Offset, const size_t _Size) noexcept {
+        // Note: A non-cached read must cover whole sectors and target a page-aligned buffer, which
+        //       VirtualAlloc() guarantees. The size is rounded up to the sector boundary, the file
+        //       system stops at the end of the file, so only the requested bytes must be read.
+        const size_t _Aligned_size = (_Size + _Sector_alignment - 1) & ~(_Sector_alignment - 1);
+        OVERLAPPED _Overlapped     = {0};
+        _Overlapped.Offset         = static_cast<DWORD>(_Offset & 0xFFFF'FFFF);
+        _Overlapped.OffsetHigh     = static_cast<DWORD>(_Offset >> 32);
+        DWORD _Bytes_read          = 0;
+        return ::ReadFile(_Myhandle, _Mybuf, static_cast<DWORD>(_Aligned_size), &_Bytes_read,
+            &_Overlapped) != 0 && _Bytes_read >= _Size;
+    }
+
+    const byte_t* _Read_back::_Data() const noexcept {
+        return _Mybuf;
+    }
+
+    byte_t* _Read_back::_Expected() noexcept {
+        return _Mybuf + _Chunk_size;
+    }
+
+    _Block_sampler::_Block_sampler(const uint64_t _Count, const uint32_t _Coverage) noexcept
+        : _Mycount(_Count), _Mycoverage((::std::min)(_Coverage, uint32_t{100})), _Mystate(0) {}
+
+    _Block_sampler::~_Block_sampler() noexcept {}
+
+    bool _Block_sampler::_Seed() noexcept {
+        return ::mjx::fill_with_cached_random_bytes(reinterpret_cast<byte_t*>(&_Mystate), sizeof(_Mystate));
+    }
+
+    bool _Block_sampler::_Selected(const uint64_t _Block) noexcept {
+        // Note: The first and the last block are always selected, so that both ends of the file are
+        //       checked. Every other block is selected independently with the probability of the coverage,
+        //       so the selection is unpredictable, yet it does not have to be stored. SplitMix64 is good
+        //       enough for sampling.
+        if (_Mycoverage >= 100 || _Block == 0 || _Block + 1 == _Mycount) {
+            return true;
+        }
+
+        _Mystate += 0x9E37'79B9'7F4A'7C15;
+        uint64_t _Val = _Mystate;
+        _Val          = (_Val ^ (_Val >> 30)) * 0xBF58'476D'1CE4'E5B9;
+        _Val          = (_Val ^ (_Val >> 27)) * 0x94D0'49BB'1331'11EB;
+        _Val         ^= _Val >> 31;
+        return _Val % 100 < _Mycoverage;
+    }
+} // namespace mjx
\ No newline at end of file
@@ -0,0 +1,64 @@
+// verify.hpp
+
+// Copyright (c) Mateusz Jandura. All rights reserved.
+// SPDX-License-Identifier: Apache-2.0
+
+#pragma once
+#ifndef _FSHRED_VERIFY_HPP_
+#define _FSHRED_VERIFY_HPP_
+#include <cstddef>
+#include <cstdint>
+#include <fshred/tinywin.hpp>
+#include <mjfs/file.hpp>
+#include <mjstr/char_traits.hpp>
+
+namespace mjx {
+    class _Read_back { // reads the data of a file from the device, bypassing the system cache
+    public:
+        explicit _Read_back(const file& _File) noexcept;
+        ~_Read_back() noexcept;
+
+        _Read_back(const _Read_back&)            = delete;
+        _Read_back& operator=(const _Read_back&) = delete;
+
+        bool _Valid() const noexcept;
+
+        // reads the data at the offset, which must be aligned to the sector size
+        bool _Read(const uint64_t _Offset, const size_t _Size) noexcept;
+
+        // returns the data read by the last call to _Read()
+        const byte_t* _Data() const noexcept;
+
+        // returns the buffer that receives the expected data, large enough for a chunk
+        byte_t* _Expected() noexcept;
+
+        static constexpr size_t _Chunk_size = 1048576; // 1 MiB
+
+    private:
+        static constexpr size_t _Sector_alignment = 4096; // a multiple of every common sector size
+
+        HANDLE _Myhandle;
+        byte_t* _Mybuf; // a chunk of read data followed by a chunk of expected data
+    };
+
+    class _Block_sampler { // selects the blocks read back by a sampled verification
+    public:
+        _Block_sampler(const uint64_t _Count, const uint32_t _Coverage) noexcept;
+        ~_Block_sampler() noexcept;
+
+        // draws a new selection from the system generator
+        bool _Seed() noexcept;
+
+        // checks whether the block should be read back
+        bool _Selected(const uint64_t _Block) noexcept;
+
+        static constexpr size_t _Block_size = 65536; // 64 KiB, a multiple of every common sector size
+
+    private:
+        uint64_t _Mycount; // number of blocks in the file
+        uint32_t _Mycoverage; // percentage of the blocks to select
+        uint64_t _Mystate;
+    };
+} // namespace mjx
+
+#endif // _FSHRED_VERIFY_HPP_
\ No newline at end of file
@@ -0,0 +1,100 @@
+// writeback.cpp
+
+// Copyright (c) Mateusz Jandura. All rights reserved.
+// SPDX-License-Identifier: Apache-2.0
+
+#include <fshred/device.hpp>
+#include <fshred/tinywin.hpp>
+#include <fshred/writeback.hpp>
+
+namespace mjx {
+    _Write_behind::_Write_behind(file& _File, const uint64_t _Window) noexcept
+        : _Myfile(_File), _Mywindow(_Window), _Mypending(0), _Mymtx(), _Mystate_changed(),
+        _Myrequested(false), _Mystopping(false), _Myresult(true), _Myflush_handle(INVALID_HANDLE_VALUE),
+        _Mythread() {}
+
+    _Write_behind::~_Write_behind() noexcept {
+        if (_Mythread.joinable()) {
+            {
+                ::std::lock_guard<::std::mutex> _Guard(_Mymtx);
+                _Mystopping = true;
+            }
+
+            _Mystate_changed.notify_all();
+            _Mythread.join(); // finishes the pending writeback first
+        }
+
+        if (_Myflush_handle != INVALID_HANDLE_VALUE) {
+            ::CloseHandle(_Myflush_handle);
+            _Myflush_handle = INVALID_HANDLE_VALUE;
+        }
+    }
+
+    void _Write_behind::_Run() noexcept {
+        const HANDLE _Handle =
+            _Myflush_handle != INVALID_HANDLE_VALUE ? _Myflush_handle : _Myfile.native_handle();
+        bool _Flushed;
+        ::std::unique_lock<::std::mutex> _Lock(_Mymtx);
+        for (;;) {
+            _Mystate_changed.wait(_Lock, [this] { return _Myrequested || _Mystopping; });
+            if (!_Myrequested) { // stopped, nothing to write back
+                return;
+            }
+
+            _Lock.unlock();
+            _Flushed = ::mjx::_Flush_file_data(_Handle);
+            _Lock.lock();
+            _Myresult    = _Myresult && _Flushed;
+            _Myrequested = false;
+            _Mystate_changed.notify_all();
+        }
+    }
+
+    bool _Write_behind::_Start() noexcept {
+        // Note: Windows cannot start the writeback of a range without waiting for it, so the helper
+        //       flushes the file data while the shredder keeps writing. The flush covers the whole
+        //       file, but only the data written since the previous one is still dirty. The writes go
+        //       through a synchronous handle, which serializes its own calls, so the helper flushes
+        //       through a second handle. If that cannot be opened, the writes wait for the flushes.
+        //       Since the previous writeback is awaited first, at most two windows are dirty at once.
+        if (!_Mythread.joinable()) {
+            _Myflush_handle = ::ReOpenFile(_Myfile.native_handle(), GENERIC_WRITE,
+                FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, 0);
+            try {
+                _Mythread = ::std::thread(&_Write_behind::_Run, this);
+            } catch (...) { // could not start the helper, write the data back synchronously
+                return ::mjx::flush_file_data(_Myfile);
+            }
+        }
+
+        {
+            ::std::lock_guard<::std::mutex> _Guard(_Mymtx);
+            _Myrequested = true;
+        }
+
+        _Mystate_changed.notify_all();
+        return true;
+    }
+
+    bool _Write_behind::_Advance(const size_t _Size) noexcept {
+        if (_Mywindow == 0) { // write-behind disabled, do nothing
+            return true;
+        }
+
+        _Mypending += static_cast<uint64_t>(_Size);
+        if (_Mypending < _Mywindow) { // window not filled yet
+            return true;
+        }
+
+        _Mypending = 0;
+        return _Wait() && _Start();
+    }
+
+    bool _Write_behind::_Wait() noexcept {
+        ::std::unique_lock<::std::mutex> _Lock(_Mymtx);
+        _Mystate_changed.wait(_Lock, [this] { return !_Myrequested; });
+        const bool _Result = _Myresult;
+        _Myresult          = true;
+        return _Result;
+    }
+} // namespace mjx
\ No newline at end of file
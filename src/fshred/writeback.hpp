@@ -0,0 +1,54 @@
+// writeback.hpp
+
+// Copyright (c) Mateusz Jandura. All rights reserved.
+// SPDX-License-Identifier: Apache-2.0
+
+#pragma once
+#ifndef _FSHRED_WRITEBACK_HPP_
+#define _FSHRED_WRITEBACK_HPP_
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <fshred/tinywin.hpp>
+#include <mjfs/file.hpp>
+#include <mutex>
+#include <thread>
+
+namespace mjx {
+    class _Write_behind { // bounds the amount of dirty data of a file during buffered shredding
+    public:
+        _Write_behind(file& _File, const uint64_t _Window) noexcept;
+        ~_Write_behind() noexcept;
+
+        _Write_behind(const _Write_behind&)            = delete;
+        _Write_behind& operator=(const _Write_behind&) = delete;
+
+        // accounts written bytes, starts the writeback once a window is filled
+        bool _Advance(const size_t _Size) noexcept;
+
+        // waits for the pending writeback
+        bool _Wait() noexcept;
+
+    private:
+        // starts the writeback of all data written so far
+        bool _Start() noexcept;
+
+        // writes the data back whenever requested, until the object is destroyed
+        void _Run() noexcept;
+
+        // Note: A single helper serves the whole file. It is started with the first filled window,
+        //       so files smaller than a window never start it.
+        file& _Myfile;
+        uint64_t _Mywindow; // 0 if disabled
+        uint64_t _Mypending; // bytes written since the last writeback started
+        ::std::mutex _Mymtx;
+        ::std::condition_variable _Mystate_changed; // signaled on a request, a finished writeback or a stop
+        bool _Myrequested; // a writeback has been requested and has not finished yet
+        bool _Mystopping;
+        bool _Myresult; // false once a writeback has failed, until it is reported by _Wait()
+        HANDLE _Myflush_handle; // second handle used by the helper, INVALID_HANDLE_VALUE if not opened
+        ::std::thread _Mythread;
+    };
+} // namespace mjx
+
+#endif // _FSHRED_WRITEBACK_HPP_
\ No newline at end of file